@@ -10,11 +10,13 @@
 #include <unordered_map>
 #include <filesystem>
 
-#include "gameobject.h"
+#include "drawable.h"
+#include "heightfield.h"
 #include "shadermanager.h"
 #include "vertexarrayobject.h"
 #include "texture.h"
 #include "cubemap.h"
+#include "materialtable.h"
 
 class AssetManager
 {
@@ -25,15 +27,15 @@ public:
 		return instance;
 	}
 	
-	const GameObject& getGameObject(const std::string& key)
+	const Drawable& getDrawable(const std::string& key)
 	{
-		auto itr = gameObjects.find(key);
+		auto itr = drawables.find(key);
 
-		if (itr != gameObjects.end())
+		if (itr != drawables.end())
 			return itr->second;
 
-		std::cout << "Cannot find GameObject: " << key << '\n';
-		return GameObject();
+		std::cout << "Cannot find Drawable: " << key << '\n';
+		return Drawable();
 	}
 
 	const VertexArrayObject& getVertexArrayObject(const std::string& key)
@@ -58,6 +60,19 @@ public:
 		return Texture();
 	}
 
+	// Baked top-down from every shape of the OBJ, in its object space
+	const HeightField& getHeightField(const std::string& key)
+	{
+		auto itr = heightFields.find(key);
+
+		if (itr != heightFields.end())
+			return itr->second;
+
+		std::cout << "Cannot find HeightField: " << key << '\n';
+		static const HeightField empty;
+		return empty;
+	}
+
 	const CubeMap& getCubeMap(const std::string& key)
 	{
 		auto itr = cubeMaps.find(key);
@@ -70,6 +85,14 @@ public:
 	}
 
 private:
+	static constexpr const char* CacheDirectory = "assetcache";
+
+	// Shapes big enough to hide others but cheap enough to rasterize every frame become occluders
+	static constexpr float OccluderMinRadius = 1.0f;
+	static const size_t OccluderMaxTriangles = 2048;
+
+	static constexpr float HeightFieldCellSize = 0.1f;
+
 	const std::vector<std::string> cubemapFilepaths =
 	{
 		"assets/cubemap/px.png",
@@ -80,10 +103,13 @@ private:
 		"assets/cubemap/nz.png"
 	};
 
-	std::unordered_map<std::string, GameObject> gameObjects;
+	std::unordered_map<std::string, Drawable> drawables;
 	std::unordered_map<std::string, VertexArrayObject> vaos;
 	std::unordered_map<std::string, Texture> textures;
 	std::unordered_map<std::string, CubeMap> cubeMaps;
+	std::unordered_map<std::string, BVH> bvhs;
+	std::unordered_map<std::string, std::vector<OccluderMesh>> occluders;
+	std::unordered_map<std::string, HeightField> heightFields;
 
 	AssetManager()
 	{
@@ -91,13 +117,14 @@ private:
 		loadTextureFiles();
 		loadObjFiles();
 		loadCubemaps();
+
+		MaterialTable::getInstance().upload();
 	}
 
 	void loadObjFiles()
 	{
 		std::string dirPath = "assets";
-		Shader texturedShader = ShaderManager::getInstance().getShader("TexturedShader");
-		Shader untexturedShader = ShaderManager::getInstance().getShader("UntexturedShader");
+		ShaderManager& shaderManager = ShaderManager::getInstance();
 
 		for (const auto& entry : std::filesystem::directory_iterator(dirPath))
 		{
@@ -128,44 +155,60 @@ private:
 						  << std::endl;
 			}
 
-			std::vector<Material> tempMaterials;
-			std::vector<Material> goMaterials;
-			std::vector<VertexArrayObject> goVaos;
+			std::vector<MaterialID> tempMaterials;
+			std::vector<MaterialID> shapeMaterials;
+			std::vector<VertexArrayObject> shapeVaos;
+			std::vector<glm::vec3> surfaceVertices;
+			std::vector<uint32_t> surfaceIndices;
 
 			for (const auto& material : tinyMaterials)
 			{
 				Material newMaterial;
+				unsigned int keywords = 0;
 
+				// Maps the MTL does not provide fall back to its constants instead of placeholder
+				// textures, so the variant skips those fetches entirely
 				if (!material.diffuse_texname.empty())
 				{
-					newMaterial.setShader(texturedShader);
-
+					keywords |= ShaderKeyword::DiffuseMap;
 					newMaterial.setTexture(textures[material.diffuse_texname]);
-
-					if (!material.bump_texname.empty())
-						newMaterial.setTexture(textures[material.bump_texname]);
-					else
-						newMaterial.setTexture(textures["default_normal.jpg"]);
-
-					if (!material.specular_texname.empty())
-						newMaterial.setTexture(textures[material.specular_texname]);
-					else
-						newMaterial.setTexture(textures["default_specular.jpg"]);
 				}
 				else
 				{
-					newMaterial.setShader(untexturedShader);
-
 					newMaterial.Diffuse[0] = material.diffuse[0];
 					newMaterial.Diffuse[1] = material.diffuse[1];
 					newMaterial.Diffuse[2] = material.diffuse[2];
+				}
+
+				if (!material.diffuse_texname.empty() && !material.bump_texname.empty())
+				{
+					keywords |= ShaderKeyword::NormalMap;
+					newMaterial.setTexture(textures[material.bump_texname]);
+				}
 
+				if (!material.specular_texname.empty())
+				{
+					keywords |= ShaderKeyword::SpecularMap;
+					newMaterial.setTexture(textures[material.specular_texname]);
+				}
+				else
+				{
 					newMaterial.Specular[0] = material.specular[0];
 					newMaterial.Specular[1] = material.specular[1];
 					newMaterial.Specular[2] = material.specular[2];
 				}
 
-				tempMaterials.push_back(newMaterial);
+				newMaterial.Opacity = material.dissolve;
+				newMaterial.Pass = classifyPass(material, newMaterial.getTexture(TextureType::Diffuse));
+				if (newMaterial.Pass == RenderPass::AlphaTested)
+					keywords |= ShaderKeyword::AlphaTest;
+
+				// Submitted now so the variant for weighted blended transparency compiles while assets load
+				if (newMaterial.Pass == RenderPass::Transparent)
+					shaderManager.getVariant(keywords | ShaderKeyword::WeightedOIT);
+
+				newMaterial.setShader(shaderManager.getVariant(keywords));
+				tempMaterials.push_back(MaterialLibrary::getInstance().intern(newMaterial));
 			}
 
 			for (const auto& shape : tinyShapes)
@@ -177,17 +220,65 @@ private:
 				const auto& indices = mesh.indices;
 
 				VertexArrayObject newVAO = VertexArrayObject(pos, norm, tex, indices);
+				MaterialID shapeMaterial = tempMaterials[mesh.material_ids[0]]; // Assume every face ID is equal
 
 				vaos.insert(std::make_pair(name, newVAO));
 
-				goVaos.push_back(newVAO);
-				goMaterials.push_back(tempMaterials[mesh.material_ids[0]]); // Assume every face ID is equal
+				// Cut out and see-through shapes would hide what shows through them
+				bool isOpaque = MaterialLibrary::getInstance().get(shapeMaterial).Pass == RenderPass::Opaque;
+				if (isOpaque && newVAO.LocalBounds.Radius >= OccluderMinRadius && indices.size() / 3 <= OccluderMaxTriangles)
+				{
+					OccluderMesh occluder;
+					for (size_t i = 0; i + 2 < pos.size(); i += 3)
+						occluder.Vertices.push_back(glm::vec3(pos[i], pos[i + 1], pos[i + 2]));
+					occluder.Indices.assign(indices.begin(), indices.end());
+					occluders[name].push_back(occluder);
+				}
+
+				uint32_t baseVertex = (uint32_t)surfaceVertices.size();
+				for (size_t i = 0; i + 2 < pos.size(); i += 3)
+					surfaceVertices.push_back(glm::vec3(pos[i], pos[i + 1], pos[i + 2]));
+				for (unsigned int index : indices)
+					surfaceIndices.push_back(baseVertex + index);
+
+				shapeVaos.push_back(newVAO);
+				shapeMaterials.push_back(shapeMaterial);
 			}
 
-			gameObjects.insert(std::make_pair(name, GameObject(goVaos, goMaterials)));
+			// For particles to land on, whatever the material
+			heightFields[name].build(surfaceVertices, surfaceIndices, HeightFieldCellSize);
+
+			// Imported shapes are static relative to their object, so the hierarchy is built once
+			// in object space and reused from the asset cache on later launches
+			std::vector<Bounds> shapeBounds;
+			for (const VertexArrayObject& vao : shapeVaos)
+				shapeBounds.push_back(vao.LocalBounds);
+
+			const BVH& bvh = bvhs[name] = BVH::loadOrBuild(std::string(CacheDirectory) + '/' + name + ".bvh", shapeBounds);
+
+			Drawable drawable = Drawable(shapeVaos, shapeMaterials);
+			drawable.StaticBVH = &bvh;
+			if (occluders.count(name) > 0)
+				drawable.Occluders = &occluders[name];
+			drawables.insert(std::make_pair(name, drawable));
 		}
 	}
 
+	// A dissolve below one or a translucent diffuse alpha blends. A map_d, or a diffuse alpha that
+	// is only ever fully on or off, is cut out with an alpha test instead, which keeps depth writes
+	// and needs no sorting. map_d is assumed to be the diffuse map's alpha, as it is in our assets.
+	static RenderPass classifyPass(const tinyobj::material_t& material, const Texture& diffuse)
+	{
+		if (material.dissolve < 1.0f || diffuse.Alpha == AlphaUsage::Translucent)
+			return RenderPass::Transparent;
+
+		bool hasDiffuseMap = !material.diffuse_texname.empty();
+		if (hasDiffuseMap && (!material.alpha_texname.empty() || diffuse.Alpha == AlphaUsage::Cutout))
+			return RenderPass::AlphaTested;
+
+		return RenderPass::Opaque;
+	}
+
 	void loadTextureFiles()
 	{
 		std::string path = "assets/textures";
@@ -0,0 +1,261 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include "particlestore.h"
+#include "radixsort.h"
+#include "randomstream.h"
+#include "world.h"
+
+// CPU timings behind the numbers quoted for the particle and world paths. Run with
+// RUN_BENCHMARKS instead of opening a window; every case prints the mean over its repetitions.
+// Data is generated from fixed seeds so runs are comparable between builds.
+class Benchmarks
+{
+public:
+	static void run()
+	{
+		std::cout << "Job system workers: " << JobSystem::getInstance().getWorkerCount() << std::endl;
+		particleUpdate();
+		particleSort();
+		worldUpdate();
+		transformHierarchy();
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	template<typename Fn>
+	static double measure(int repetitions, Fn fn)
+	{
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < repetitions; i++)
+			fn();
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / repetitions;
+	}
+
+	static void report(const char* name, size_t count, double milliseconds)
+	{
+		std::cout << std::setw(32) << std::left << name << std::setw(9) << std::right << count
+			<< std::setw(10) << std::fixed << std::setprecision(3) << milliseconds << " ms" << std::endl;
+	}
+
+	static void scatter(ParticleStore& store, size_t count, uint64_t seed)
+	{
+		RandomStream random(seed);
+		store.resize(count);
+		for (size_t i = 0; i < store.getPaddedSize(); i++)
+		{
+			store.PositionX[i] = random.range(-50.0f, 50.0f);
+			store.PositionY[i] = random.range(-50.0f, 50.0f);
+			store.PositionZ[i] = random.range(-50.0f, 50.0f);
+		}
+	}
+
+	// ParticleStore's update kernel against a plain loop over the same streams, which the compiler
+	// is free to vectorize on its own
+	static void particleUpdate()
+	{
+		const float deltaTime = 0.0001f;
+
+		for (size_t count : { (size_t)10000, (size_t)100000, (size_t)1000000 })
+		{
+			ParticleStore store;
+			scatter(store, count, 11);
+
+			RandomStream random(13);
+			size_t padded = store.getPaddedSize();
+			for (size_t i = 0; i < store.size(); i++)
+			{
+				store.VelocityX[i] = random.range(-1.0f, 1.0f);
+				store.VelocityY[i] = random.range(-2.0f, 0.0f);
+				store.VelocityZ[i] = random.range(-1.0f, 1.0f);
+				store.RollSpeed[i] = random.range(-3.0f, 3.0f);
+				store.Size[i] = 0.05f;
+				store.Lifetime[i] = 1e9f;
+			}
+
+			int repetitions = (int)(100000000 / count);
+			auto expire = [&](size_t i) { store.Age[i] = 0.0f; };
+
+			double kernel = measure(repetitions, [&]() { store.update(0, padded, deltaTime, expire); });
+			double plain = measure(repetitions, [&]()
+			{
+				for (size_t i = 0; i < padded; i++)
+				{
+					store.PositionX[i] += store.VelocityX[i] * deltaTime;
+					store.PositionY[i] += store.VelocityY[i] * deltaTime;
+					store.PositionZ[i] += store.VelocityZ[i] * deltaTime;
+					store.Roll[i] += store.RollSpeed[i] * deltaTime;
+					store.Age[i] += deltaTime;
+					if (store.Age[i] >= store.Lifetime[i])
+						expire(i);
+				}
+			});
+
+			report("Particle update, kernel", count, kernel);
+			report("Particle update, plain loop", count, plain);
+		}
+	}
+
+	// Back to front order of blended particles, RadixSort against std::sort on the same keys
+	static void particleSort()
+	{
+		const glm::vec4 depthRow = glm::vec4(0.3f, -0.2f, -0.93f, 1.5f);
+
+		for (size_t count : { (size_t)10000, (size_t)100000, (size_t)1000000 })
+		{
+			ParticleStore store;
+			scatter(store, count, 7);
+
+			size_t padded = store.getPaddedSize();
+			std::vector<uint32_t> depthKeys(padded);
+			store.writeDepthKeys(0, padded, depthRow, depthKeys.data());
+
+			RadixSort radixSort;
+			std::vector<uint32_t> keys, order;
+			int repetitions = count >= 1000000 ? 5 : 20;
+
+			double radix = measure(repetitions, [&]()
+			{
+				keys = depthKeys;
+				order.resize(padded);
+				std::iota(order.begin(), order.end(), 0u);
+				radixSort.sort(keys, order);
+			});
+			double comparison = measure(repetitions, [&]()
+			{
+				order.resize(padded);
+				std::iota(order.begin(), order.end(), 0u);
+				std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return depthKeys[a] < depthKeys[b]; });
+			});
+
+			report("Particle sort, radix", count, radix);
+			report("Particle sort, std::sort", count, comparison);
+		}
+	}
+
+	// Laid out like the GameObjects the World replaced: one object per entity holding its
+	// transform, velocities and its own mesh and material vectors
+	struct ObjectPerEntity : Transformable
+	{
+		glm::vec3 Velocity;
+		glm::vec3 RotationSpeed;
+		std::vector<VertexArrayObject> VAOs;
+		std::vector<MaterialID> Materials;
+		Bounds WorldBounds;
+	};
+
+	// 100k moving meshes: World::integrate and updateTransforms against the per object loop
+	static void worldUpdate()
+	{
+		const size_t count = 100000;
+		const float deltaTime = 0.016f;
+		const int repetitions = 20;
+
+		VertexArrayObject mesh;
+		mesh.LocalBounds.Extents = glm::vec3(1.0f);
+		mesh.LocalBounds.Radius = 1.75f;
+
+		World world;
+		std::vector<ObjectPerEntity> objects(count);
+		RandomStream random(17);
+		for (size_t i = 0; i < count; i++)
+		{
+			glm::vec3 position(random.range(-50.0f, 50.0f), random.range(-50.0f, 50.0f), random.range(-50.0f, 50.0f));
+			glm::vec3 velocity(random.range(-1.0f, 1.0f), 0.0f, random.range(-1.0f, 1.0f));
+			glm::vec3 spin(0.0f, random.range(-1.0f, 1.0f), 0.0f);
+
+			Entity entity = world.create(Component::Transform | Component::Velocity | Component::RenderMesh | Component::Material | Component::WorldBounds);
+			EntityRef ref = world.get(entity);
+			ref.Table->Positions[ref.Row] = position;
+			ref.Table->LinearVelocities[ref.Row] = velocity;
+			ref.Table->AngularVelocities[ref.Row] = spin;
+			ref.Table->Meshes[ref.Row] = mesh;
+
+			objects[i].Position = position;
+			objects[i].Velocity = velocity;
+			objects[i].RotationSpeed = spin;
+			objects[i].VAOs.push_back(mesh);
+			objects[i].Materials.push_back(0);
+		}
+		world.updateTransforms();
+
+		double archetypes = measure(repetitions, [&]()
+		{
+			world.integrate(deltaTime);
+			world.updateTransforms();
+		});
+		double perObject = measure(repetitions, [&]()
+		{
+			for (ObjectPerEntity& object : objects)
+			{
+				object.Position += object.Velocity * deltaTime;
+				object.Rotation += object.RotationSpeed * deltaTime;
+
+				// GameObject::update built its matrix through a chain of 4x4 products
+				object.Model = glm::translate(glm::mat4(1.0f), object.Position);
+				object.Model = glm::rotate(object.Model, object.Rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
+				object.Model = glm::rotate(object.Model, object.Rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
+				object.Model = glm::rotate(object.Model, object.Rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
+				object.Model = glm::scale(object.Model, object.Scale);
+				object.WorldBounds = object.VAOs[0].LocalBounds.transformed(object.Model);
+			}
+		});
+
+		report("World update, archetypes", count, archetypes);
+		report("World update, per object", count, perObject);
+	}
+
+	// 100k entities as 1k roots with 99 children each, only the roots are marked dirty
+	static void transformHierarchy()
+	{
+		const int rootCount = 1000;
+		const int childCount = 99;
+		const int repetitions = 20;
+
+		World world;
+		std::vector<Entity> roots;
+		for (int i = 0; i < rootCount; i++)
+		{
+			Entity root = world.create(Component::Transform);
+			roots.push_back(root);
+			for (int j = 0; j < childCount; j++)
+			{
+				Entity child = world.create(Component::Transform | Component::RenderMesh | Component::WorldBounds);
+				EntityRef ref = world.get(child);
+				ref.Table->Positions[ref.Row] = glm::vec3((float)j, 0.0f, 0.0f);
+				world.setParent(child, root);
+			}
+		}
+
+		size_t count = (size_t)rootCount * (childCount + 1);
+		report("Hierarchy, first update", count, measure(1, [&]() { world.updateTransforms(); }));
+		report("Hierarchy, static", count, measure(repetitions, [&]() { world.updateTransforms(); }));
+		report("Hierarchy, 1 root moved", count, measure(repetitions, [&]()
+		{
+			world.markDirty(roots[rootCount / 2]);
+			world.updateTransforms();
+		}));
+		report("Hierarchy, 10 roots moved", count, measure(repetitions, [&]()
+		{
+			for (int i = 0; i < 10; i++)
+				world.markDirty(roots[i * (rootCount / 10)]);
+			world.updateTransforms();
+		}));
+		report("Hierarchy, all roots moved", count, measure(repetitions, [&]()
+		{
+			for (Entity root : roots)
+				world.markDirty(root);
+			world.updateTransforms();
+		}));
+	}
+
+public:
+	Benchmarks() = delete;
+};
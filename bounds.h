@@ -0,0 +1,66 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+// Axis aligned box in center/extent form plus a bounding sphere around the same center.
+// The sphere is usually tighter for round meshes, the box for flat or elongated ones, so culling
+// tests against whichever of the two is smaller along each plane normal.
+struct Bounds
+{
+	glm::vec3 Center;
+	glm::vec3 Extents;
+	float Radius;
+
+	Bounds()
+	{
+		Center = glm::vec3();
+		Extents = glm::vec3();
+		Radius = 0.0f;
+	}
+
+	// Positions are tightly packed xyz triples, as handed to VertexArrayObject
+	static Bounds fromPositions(const std::vector<float>& pos)
+	{
+		Bounds bounds;
+		if (pos.size() < 3)
+			return bounds;
+
+		glm::vec3 min = glm::vec3(pos[0], pos[1], pos[2]);
+		glm::vec3 max = min;
+		for (size_t i = 3; i + 2 < pos.size(); i += 3)
+		{
+			glm::vec3 p = glm::vec3(pos[i], pos[i + 1], pos[i + 2]);
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+
+		bounds.Center = (min + max) * 0.5f;
+		bounds.Extents = (max - min) * 0.5f;
+
+		float radiusSq = 0.0f;
+		for (size_t i = 0; i + 2 < pos.size(); i += 3)
+		{
+			glm::vec3 offset = glm::vec3(pos[i], pos[i + 1], pos[i + 2]) - bounds.Center;
+			radiusSq = glm::max(radiusSq, glm::dot(offset, offset));
+		}
+		bounds.Radius = std::sqrt(radiusSq);
+
+		return bounds;
+	}
+
+	// Box transformed by the absolute rotation/scale part, sphere scaled by the largest axis scale
+	Bounds transformed(const glm::mat4& model) const
+	{
+		glm::mat3 basis = glm::mat3(model);
+		glm::mat3 absBasis = glm::mat3(glm::abs(basis[0]), glm::abs(basis[1]), glm::abs(basis[2]));
+		float maxScale = glm::max(glm::length(basis[0]), glm::max(glm::length(basis[1]), glm::length(basis[2])));
+
+		Bounds world;
+		world.Center = glm::vec3(model * glm::vec4(Center, 1.0f));
+		world.Extents = absBasis * Extents;
+		world.Radius = Radius * maxScale;
+		return world;
+	}
+};
@@ -0,0 +1,682 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bounds.h"
+#include "frustum.h"
+
+// Four children per node, stored as SoA so one SSE register holds the same coordinate of all
+// four boxes. Only the first ChildCount slots are valid. A slot with Count > 0 is a leaf covering
+// Primitives[Child, Child + Count), otherwise Child is the index of another node.
+struct alignas(64) BVHNode
+{
+	float MinX[4], MinY[4], MinZ[4];
+	float MaxX[4], MaxY[4], MaxZ[4];
+	uint32_t Child[4];
+	uint32_t Count[4];
+	uint32_t ChildCount;
+};
+
+struct BVHPrimitive
+{
+	glm::vec3 Min;
+	glm::vec3 Max;
+};
+
+struct BVHHit
+{
+	uint32_t Primitive;
+	float Distance;
+};
+
+// Static bounding volume hierarchy over primitive bounds, built with binned SAH and collapsed
+// into a flattened 4-wide tree. Primitive indices are the positions in the bounds list passed to
+// build(), which for imported objects are submesh indices. Queries work in the space the bounds
+// were given in; pass viewProjection * model to query an object placed with model.
+class BVH
+{
+public:
+	static const int MaxLeafSize = 4;
+	static const int BinCount = 12;
+	// Deeper nodes split at the centroid median, so no input makes the tree deeper than
+	// MaxSAHDepth plus 32 levels
+	static const int MaxSAHDepth = 32;
+
+	std::vector<BVHNode> Nodes;
+	std::vector<uint32_t> Primitives;
+	std::vector<BVHPrimitive> PrimitiveBounds;
+
+	bool empty() const
+	{
+		return Nodes.empty();
+	}
+
+	void build(const std::vector<Bounds>& bounds)
+	{
+		Nodes.clear();
+		Primitives.clear();
+		PrimitiveBounds.clear();
+		if (bounds.empty())
+			return;
+
+		for (uint32_t i = 0; i < bounds.size(); i++)
+		{
+			PrimitiveBounds.push_back({ bounds[i].Center - bounds[i].Extents, bounds[i].Center + bounds[i].Extents });
+			Primitives.push_back(i);
+		}
+
+		std::vector<BuildNode> buildNodes;
+		buildNodes.reserve(bounds.size() * 2);
+		buildRecursive(buildNodes, 0, (uint32_t)Primitives.size(), 0);
+
+		if (buildNodes[0].Count > 0)
+		{
+			// Whole tree fits in one leaf, still give it a root so queries have a single entry point
+			Nodes.emplace_back();
+			BVHNode& root = Nodes.back();
+			root = BVHNode();
+			setSlot(root, 0, buildNodes[0].Min, buildNodes[0].Max, buildNodes[0].First, buildNodes[0].Count);
+			root.ChildCount = 1;
+			return;
+		}
+
+		flatten(buildNodes, 0);
+	}
+
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const
+	{
+		queryFrustum(frustum, visible, [](const glm::vec3&, const glm::vec3&) { return false; });
+	}
+
+	// isOccluded(min, max) is asked for every node and primitive that survives the frustum test,
+	// returning true drops the whole subtree
+	template<typename OcclusionTest>
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& visible, OcclusionTest isOccluded) const
+	{
+		if (Nodes.empty())
+			return;
+
+		// Subtrees found fully inside the frustum skip the remaining plane tests
+		struct StackEntry { uint32_t node; bool inside; };
+		StackEntry stack[StackSize];
+		int stackSize = 0;
+		stack[stackSize++] = { 0, false };
+
+		while (stackSize > 0)
+		{
+			assert(stackSize + 3 <= StackSize);
+			StackEntry entry = stack[--stackSize];
+			const BVHNode& node = Nodes[entry.node];
+			int validMask = (1 << node.ChildCount) - 1;
+
+			int insideMask = validMask;
+			int visibleMask = entry.inside ? validMask : testFrustum(node, frustum, insideMask) & validMask;
+
+			for (int slot = 0; slot < 4; slot++)
+			{
+				if ((visibleMask & (1 << slot)) == 0)
+					continue;
+
+				glm::vec3 min = glm::vec3(node.MinX[slot], node.MinY[slot], node.MinZ[slot]);
+				glm::vec3 max = glm::vec3(node.MaxX[slot], node.MaxY[slot], node.MaxZ[slot]);
+				if (isOccluded(min, max))
+					continue;
+
+				bool inside = entry.inside || (insideMask & (1 << slot)) != 0;
+				if (node.Count[slot] == 0)
+				{
+					stack[stackSize++] = { node.Child[slot], inside };
+					continue;
+				}
+
+				for (uint32_t i = node.Child[slot]; i < node.Child[slot] + node.Count[slot]; i++)
+				{
+					const BVHPrimitive& primitive = PrimitiveBounds[Primitives[i]];
+					if (node.Count[slot] > 1)
+					{
+						if (!inside && isOutside(frustum, primitive))
+							continue;
+						if (isOccluded(primitive.Min, primitive.Max))
+							continue;
+					}
+					visible.push_back(Primitives[i]);
+				}
+			}
+		}
+	}
+
+	// Nearest primitive whose bounds the ray enters within maxDistance. direction must be normalized.
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BVHHit& hit) const
+	{
+		return raycast(origin, direction, maxDistance, hit, [](uint32_t) { return true; });
+	}
+
+	// accept(primitive) is asked before a primitive's bounds are tested, returning false skips it
+	template<typename Filter>
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BVHHit& hit, Filter accept) const
+	{
+		if (Nodes.empty())
+			return false;
+
+		glm::vec3 invDirection = 1.0f / direction;
+		hit.Primitive = InvalidIndex;
+		hit.Distance = maxDistance;
+
+		struct StackEntry { uint32_t node; float distance; };
+		StackEntry stack[StackSize];
+		int stackSize = 0;
+		stack[stackSize++] = { 0, 0.0f };
+
+		while (stackSize > 0)
+		{
+			assert(stackSize + 3 <= StackSize);
+			StackEntry entry = stack[--stackSize];
+			if (entry.distance > hit.Distance)
+				continue;
+
+			const BVHNode& node = Nodes[entry.node];
+			float distances[4];
+			int hitMask = intersectRay(node, origin, invDirection, hit.Distance, distances) & ((1 << node.ChildCount) - 1);
+
+			// Push farther children first so the nearest one is popped next
+			int order[4];
+			int hitCount = 0;
+			for (int slot = 0; slot < 4; slot++)
+			{
+				if ((hitMask & (1 << slot)) == 0)
+					continue;
+
+				int i = hitCount++;
+				for (; i > 0 && distances[order[i - 1]] < distances[slot]; i--)
+					order[i] = order[i - 1];
+				order[i] = slot;
+			}
+
+			for (int i = 0; i < hitCount; i++)
+			{
+				int slot = order[i];
+				if (node.Count[slot] == 0)
+				{
+					stack[stackSize++] = { node.Child[slot], distances[slot] };
+					continue;
+				}
+
+				for (uint32_t p = node.Child[slot]; p < node.Child[slot] + node.Count[slot]; p++)
+				{
+					if (!accept(Primitives[p]))
+						continue;
+
+					float distance;
+					if (intersectPrimitive(PrimitiveBounds[Primitives[p]], origin, invDirection, hit.Distance, distance))
+					{
+						hit.Primitive = Primitives[p];
+						hit.Distance = distance;
+					}
+				}
+			}
+		}
+
+		return hit.Primitive != InvalidIndex;
+	}
+
+	bool intersectSegment(const glm::vec3& from, const glm::vec3& to, BVHHit& hit) const
+	{
+		return intersectSegment(from, to, hit, [](uint32_t) { return true; });
+	}
+
+	template<typename Filter>
+	bool intersectSegment(const glm::vec3& from, const glm::vec3& to, BVHHit& hit, Filter accept) const
+	{
+		glm::vec3 delta = to - from;
+		float length = glm::length(delta);
+		if (length <= 0.0f)
+			return false;
+
+		return raycast(from, delta / length, length, hit, accept);
+	}
+
+	// Hashes the build parameters and the input bounds, a cached tree is only reused when neither
+	// changed
+	static uint64_t makeSourceKey(const std::vector<Bounds>& bounds)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		int parameters[3] = { MaxLeafSize, BinCount, MaxSAHDepth };
+		hashBytes(hash, parameters, sizeof(parameters));
+		for (const Bounds& b : bounds)
+		{
+			float values[7] = { b.Center.x, b.Center.y, b.Center.z, b.Extents.x, b.Extents.y, b.Extents.z, b.Radius };
+			hashBytes(hash, values, sizeof(values));
+		}
+		return hash;
+	}
+
+	bool save(const std::string& path, uint64_t sourceKey) const
+	{
+		std::error_code error;
+		std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Cannot write BVH: " << path << '\n';
+			return false;
+		}
+
+		Header header = { { 'B', 'V', 'H', '1' }, (uint32_t)sizeof(BVHNode), sourceKey,
+			(uint32_t)Nodes.size(), (uint32_t)Primitives.size() };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(Nodes.data()), Nodes.size() * sizeof(BVHNode));
+		file.write(reinterpret_cast<const char*>(Primitives.data()), Primitives.size() * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(PrimitiveBounds.data()), PrimitiveBounds.size() * sizeof(BVHPrimitive));
+		return true;
+	}
+
+	bool load(const std::string& path, uint64_t sourceKey)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		Header header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+			return false;
+
+		if (std::string(header.magic, 4) != "BVH1" || header.nodeSize != sizeof(BVHNode) || header.sourceKey != sourceKey)
+			return false;
+
+		Nodes.resize(header.nodeCount);
+		Primitives.resize(header.primitiveCount);
+		PrimitiveBounds.resize(header.primitiveCount);
+
+		if (!file.read(reinterpret_cast<char*>(Nodes.data()), Nodes.size() * sizeof(BVHNode))
+			|| !file.read(reinterpret_cast<char*>(Primitives.data()), Primitives.size() * sizeof(uint32_t))
+			|| !file.read(reinterpret_cast<char*>(PrimitiveBounds.data()), PrimitiveBounds.size() * sizeof(BVHPrimitive)))
+		{
+			Nodes.clear();
+			Primitives.clear();
+			PrimitiveBounds.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	static BVH loadOrBuild(const std::string& path, const std::vector<Bounds>& bounds)
+	{
+		BVH bvh;
+		uint64_t sourceKey = makeSourceKey(bounds);
+		if (bvh.load(path, sourceKey))
+			return bvh;
+
+		bvh.build(bounds);
+		bvh.save(path, sourceKey);
+		return bvh;
+	}
+
+private:
+	static const uint32_t InvalidIndex = 0xFFFFFFFF;
+	static const int StackSize = 256;
+
+	// Every 4-wide node is at least one binary level, and traversal leaves at most three siblings
+	// per level on the stack plus the four children of the deepest node
+	static_assert(3 * (MaxSAHDepth + 32) + 4 <= StackSize, "BVH traversal stack too small for the deepest tree");
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t nodeSize;
+		uint64_t sourceKey;
+		uint32_t nodeCount;
+		uint32_t primitiveCount;
+	};
+
+	struct BuildNode
+	{
+		glm::vec3 Min;
+		glm::vec3 Max;
+		uint32_t Left;
+		uint32_t Right;
+		uint32_t First;
+		uint32_t Count; // 0 for inner nodes
+	};
+
+	struct Bin
+	{
+		glm::vec3 Min;
+		glm::vec3 Max;
+		uint32_t Count;
+	};
+
+	static float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+	{
+		glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	glm::vec3 centroid(uint32_t primitive) const
+	{
+		return (PrimitiveBounds[primitive].Min + PrimitiveBounds[primitive].Max) * 0.5f;
+	}
+
+	static void hashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	}
+
+	uint32_t buildRecursive(std::vector<BuildNode>& buildNodes, uint32_t first, uint32_t count, int depth)
+	{
+		BuildNode node;
+		node.Min = glm::vec3(FLT_MAX);
+		node.Max = glm::vec3(-FLT_MAX);
+		glm::vec3 centroidMin = glm::vec3(FLT_MAX);
+		glm::vec3 centroidMax = glm::vec3(-FLT_MAX);
+
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			const BVHPrimitive& primitive = PrimitiveBounds[Primitives[i]];
+			node.Min = glm::min(node.Min, primitive.Min);
+			node.Max = glm::max(node.Max, primitive.Max);
+			centroidMin = glm::min(centroidMin, centroid(Primitives[i]));
+			centroidMax = glm::max(centroidMax, centroid(Primitives[i]));
+		}
+
+		node.Left = node.Right = 0;
+		node.First = first;
+		node.Count = count;
+
+		uint32_t index = (uint32_t)buildNodes.size();
+		buildNodes.push_back(node);
+		if (count <= MaxLeafSize)
+			return index;
+
+		if (depth >= MaxSAHDepth)
+		{
+			glm::vec3 extent = centroidMax - centroidMin;
+			int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+			uint32_t middle = first + count / 2;
+			std::nth_element(Primitives.data() + first, Primitives.data() + middle, Primitives.data() + first + count, [&](uint32_t a, uint32_t b)
+			{
+				return centroid(a)[axis] < centroid(b)[axis];
+			});
+			return split(buildNodes, index, first, middle, count, depth);
+		}
+
+		// Binned SAH, one traversal step is costed like one primitive test
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		int bestSplit = 0;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 0.0f)
+				continue;
+
+			Bin bins[BinCount];
+			for (Bin& bin : bins)
+				bin = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX), 0 };
+
+			float scale = BinCount / extent;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				const BVHPrimitive& primitive = PrimitiveBounds[Primitives[i]];
+				int b = std::min(BinCount - 1, (int)((centroid(Primitives[i])[axis] - centroidMin[axis]) * scale));
+				bins[b].Min = glm::min(bins[b].Min, primitive.Min);
+				bins[b].Max = glm::max(bins[b].Max, primitive.Max);
+				bins[b].Count++;
+			}
+
+			float leftArea[BinCount - 1];
+			uint32_t leftCount[BinCount - 1];
+			glm::vec3 sweepMin = glm::vec3(FLT_MAX);
+			glm::vec3 sweepMax = glm::vec3(-FLT_MAX);
+			uint32_t sweepCount = 0;
+			for (int b = 0; b < BinCount - 1; b++)
+			{
+				sweepMin = glm::min(sweepMin, bins[b].Min);
+				sweepMax = glm::max(sweepMax, bins[b].Max);
+				sweepCount += bins[b].Count;
+				leftArea[b] = surfaceArea(sweepMin, sweepMax);
+				leftCount[b] = sweepCount;
+			}
+
+			sweepMin = glm::vec3(FLT_MAX);
+			sweepMax = glm::vec3(-FLT_MAX);
+			sweepCount = 0;
+			for (int b = BinCount - 1; b > 0; b--)
+			{
+				sweepMin = glm::min(sweepMin, bins[b].Min);
+				sweepMax = glm::max(sweepMax, bins[b].Max);
+				sweepCount += bins[b].Count;
+
+				if (leftCount[b - 1] == 0 || sweepCount == 0)
+					continue;
+
+				float cost = leftCount[b - 1] * leftArea[b - 1] + sweepCount * surfaceArea(sweepMin, sweepMax);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+
+		float area = surfaceArea(node.Min, node.Max);
+		if (bestAxis >= 0 && area + bestCost >= count * area && count <= MaxLeafSize * 4)
+			return index;
+
+		uint32_t middle = first + count / 2;
+		if (bestAxis >= 0)
+		{
+			float scale = BinCount / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+			uint32_t* split = std::partition(Primitives.data() + first, Primitives.data() + first + count, [&](uint32_t primitive)
+			{
+				int b = std::min(BinCount - 1, (int)((centroid(primitive)[bestAxis] - centroidMin[bestAxis]) * scale));
+				return b < bestSplit;
+			});
+			middle = (uint32_t)(split - Primitives.data());
+		}
+
+		// Coincident centroids, fall back to an even split
+		if (middle == first || middle == first + count)
+			middle = first + count / 2;
+
+		return split(buildNodes, index, first, middle, count, depth);
+	}
+
+	uint32_t split(std::vector<BuildNode>& buildNodes, uint32_t index, uint32_t first, uint32_t middle, uint32_t count, int depth)
+	{
+		uint32_t left = buildRecursive(buildNodes, first, middle - first, depth + 1);
+		uint32_t right = buildRecursive(buildNodes, middle, first + count - middle, depth + 1);
+		buildNodes[index].Left = left;
+		buildNodes[index].Right = right;
+		buildNodes[index].Count = 0;
+		return index;
+	}
+
+	// Pulls grandchildren up until each node has four children, opening the largest inner child first
+	uint32_t flatten(const std::vector<BuildNode>& buildNodes, uint32_t buildIndex)
+	{
+		uint32_t children[4] = { buildNodes[buildIndex].Left, buildNodes[buildIndex].Right };
+		int childCount = 2;
+
+		while (childCount < 4)
+		{
+			int widest = -1;
+			float widestArea = -1.0f;
+			for (int i = 0; i < childCount; i++)
+			{
+				const BuildNode& child = buildNodes[children[i]];
+				float area = surfaceArea(child.Min, child.Max);
+				if (child.Count == 0 && area > widestArea)
+				{
+					widest = i;
+					widestArea = area;
+				}
+			}
+
+			if (widest < 0)
+				break;
+
+			uint32_t opened = children[widest];
+			children[widest] = buildNodes[opened].Left;
+			children[childCount++] = buildNodes[opened].Right;
+		}
+
+		uint32_t nodeIndex = (uint32_t)Nodes.size();
+		Nodes.emplace_back();
+		Nodes[nodeIndex] = BVHNode();
+		Nodes[nodeIndex].ChildCount = childCount;
+
+		for (int slot = 0; slot < childCount; slot++)
+		{
+			const BuildNode& child = buildNodes[children[slot]];
+			uint32_t target = child.Count > 0 ? child.First : flatten(buildNodes, children[slot]);
+			setSlot(Nodes[nodeIndex], slot, child.Min, child.Max, target, child.Count);
+		}
+
+		return nodeIndex;
+	}
+
+	static void setSlot(BVHNode& node, int slot, const glm::vec3& min, const glm::vec3& max, uint32_t child, uint32_t count)
+	{
+		node.MinX[slot] = min.x; node.MinY[slot] = min.y; node.MinZ[slot] = min.z;
+		node.MaxX[slot] = max.x; node.MaxY[slot] = max.y; node.MaxZ[slot] = max.z;
+		node.Child[slot] = child;
+		node.Count[slot] = count;
+	}
+
+	static bool isOutside(const Frustum& frustum, const BVHPrimitive& primitive)
+	{
+		glm::vec3 center = (primitive.Min + primitive.Max) * 0.5f;
+		glm::vec3 extents = (primitive.Max - primitive.Min) * 0.5f;
+		for (const glm::vec4& plane : frustum.Planes)
+		{
+			float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			if (distance + glm::dot(glm::abs(glm::vec3(plane)), extents) < 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	static bool intersectPrimitive(const BVHPrimitive& primitive, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& distance)
+	{
+		glm::vec3 t1 = (primitive.Min - origin) * invDirection;
+		glm::vec3 t2 = (primitive.Max - origin) * invDirection;
+		glm::vec3 tMin = glm::min(t1, t2);
+		glm::vec3 tMax = glm::max(t1, t2);
+
+		float tNear = glm::max(glm::max(tMin.x, tMin.y), glm::max(tMin.z, 0.0f));
+		float tFar = glm::min(glm::min(tMax.x, tMax.y), glm::min(tMax.z, maxDistance));
+		distance = tNear;
+		return tNear <= tFar;
+	}
+
+#ifdef FRUSTUM_SSE
+	// Returns the mask of children not fully behind any plane, insideMask gets those fully in front of all
+	static int testFrustum(const BVHNode& node, const Frustum& frustum, int& insideMask)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+
+		__m128 minX = _mm_load_ps(node.MinX), maxX = _mm_load_ps(node.MaxX);
+		__m128 minY = _mm_load_ps(node.MinY), maxY = _mm_load_ps(node.MaxY);
+		__m128 minZ = _mm_load_ps(node.MinZ), maxZ = _mm_load_ps(node.MaxZ);
+		__m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half), ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+		__m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half), ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+		__m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half), ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+		__m128 outside = zero;
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (const glm::vec4& plane : frustum.Planes)
+		{
+			__m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(cx, nx), _mm_mul_ps(cy, ny)),
+				_mm_add_ps(_mm_mul_ps(cz, nz), _mm_set1_ps(plane.w)));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(ex, _mm_andnot_ps(signMask, nx)), _mm_mul_ps(ey, _mm_andnot_ps(signMask, ny))),
+				_mm_mul_ps(ez, _mm_andnot_ps(signMask, nz)));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_sub_ps(distance, radius), zero));
+		}
+
+		insideMask = _mm_movemask_ps(inside);
+		return ~_mm_movemask_ps(outside) & 0xF;
+	}
+
+	// Slab test against all four children, distances gets the entry distance of each hit
+	static int intersectRay(const BVHNode& node, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float distances[4])
+	{
+		__m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+		__m128 ix = _mm_set1_ps(invDirection.x), iy = _mm_set1_ps(invDirection.y), iz = _mm_set1_ps(invDirection.z);
+
+		__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MinX), ox), ix);
+		__m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaxX), ox), ix);
+		__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MinY), oy), iy);
+		__m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaxY), oy), iy);
+		__m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MinZ), oz), iz);
+		__m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaxZ), oz), iz);
+
+		__m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)), _mm_max_ps(_mm_min_ps(t1z, t2z), _mm_setzero_ps()));
+		__m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)), _mm_min_ps(_mm_max_ps(t1z, t2z), _mm_set1_ps(maxDistance)));
+
+		_mm_storeu_ps(distances, tNear);
+		return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+	}
+#else
+	static int testFrustum(const BVHNode& node, const Frustum& frustum, int& insideMask)
+	{
+		int visibleMask = 0;
+		insideMask = 0;
+		for (int slot = 0; slot < 4; slot++)
+		{
+			BVHPrimitive box = { glm::vec3(node.MinX[slot], node.MinY[slot], node.MinZ[slot]), glm::vec3(node.MaxX[slot], node.MaxY[slot], node.MaxZ[slot]) };
+			glm::vec3 center = (box.Min + box.Max) * 0.5f;
+			glm::vec3 extents = (box.Max - box.Min) * 0.5f;
+
+			bool outside = false;
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.Planes)
+			{
+				float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+				float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+				outside |= distance + radius < 0.0f;
+				inside &= distance - radius >= 0.0f;
+			}
+
+			visibleMask |= outside ? 0 : 1 << slot;
+			insideMask |= inside ? 1 << slot : 0;
+		}
+		return visibleMask;
+	}
+
+	static int intersectRay(const BVHNode& node, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float distances[4])
+	{
+		int hitMask = 0;
+		for (int slot = 0; slot < 4; slot++)
+		{
+			BVHPrimitive box = { glm::vec3(node.MinX[slot], node.MinY[slot], node.MinZ[slot]), glm::vec3(node.MaxX[slot], node.MaxY[slot], node.MaxZ[slot]) };
+			hitMask |= intersectPrimitive(box, origin, invDirection, maxDistance, distances[slot]) ? 1 << slot : 0;
+		}
+		return hitMask;
+	}
+#endif
+};
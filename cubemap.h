@@ -3,6 +3,7 @@
 #include <glfw/glfw3.h>
 
 #include "image.h"
+#include "glstate.h"
 #include "vertexarrayobject.h"
 
 #include <assert.h>
@@ -25,7 +26,7 @@ public:
 		assert(faces.size() == 6);
 
 		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+		GLState::getInstance().bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 
 		for (size_t i = 0; i < faces.size(); i++)
 		{
@@ -58,13 +59,17 @@ public:
 
 	void draw(glm::mat4 mvp) const
 	{
-		glDepthMask(GL_FALSE);
+		// Sits on the far plane, draw after opaque geometry so covered pixels fail the depth test
+		GLState& glState = GLState::getInstance();
+		glState.setDepthMask(false);
+		glState.setDepthFunc(GL_LEQUAL);
 		shader.use();
-		shader.setMat4("u_MVP", mvp);
+		shader.setMat4(UniformLocation::MVP, mvp);
 		vao.bind();
-		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+		glState.bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-		glDepthMask(GL_TRUE);
+		glState.setDepthFunc(GL_LESS);
+		glState.setDepthMask(true);
 	}
 
 private:
@@ -0,0 +1,6 @@
+#version 430
+
+// Depth only, color writes are masked off while this runs
+void main()
+{
+}
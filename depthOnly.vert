@@ -0,0 +1,12 @@
+#version 430
+layout (location = 0) in vec3 v_position;
+
+layout (location = 1) uniform mat4 u_localToClip;
+
+// Must stay bit-identical to litShader.vert for the GL_EQUAL lighting pass
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = u_localToClip * vec4(v_position, 1.0);
+}
@@ -21,9 +21,9 @@ public:
 
 	void setOtherShaderUniforms(Shader shader) const
 	{
-		shader.setVec3("u_dirLight.direction", Direction);
-		shader.setVec3("u_dirLight.ambient", Ambient);
-		shader.setVec3("u_dirLight.diffuse", Diffuse);
-		shader.setVec3("u_dirLight.specular", Specular);
+		shader.setVec3(UniformLocation::DirLight + 0, Direction);
+		shader.setVec3(UniformLocation::DirLight + 1, Ambient);
+		shader.setVec3(UniformLocation::DirLight + 2, Diffuse);
+		shader.setVec3(UniformLocation::DirLight + 3, Specular);
 	}
 };
\ No newline at end of file
@@ -1,37 +1,24 @@
 #pragma once
 #include "vertexarrayobject.h"
-#include "material.h"
+#include "materiallibrary.h"
+#include "bvh.h"
+#include "occlusionculler.h"
 
+// Meshes and materials of an imported object, as AssetManager hands them out. Placed in a World
+// or submitted to a RenderQueue with a model matrix; it carries no transform of its own.
 class Drawable
 {
 public:
 	std::vector<VertexArrayObject> VAOs;
-	std::vector<Material> Materials;
+	std::vector<MaterialID> Materials;
+	const BVH* StaticBVH; // Over VAO bounds in local space, owned by AssetManager
+	const std::vector<OccluderMesh>* Occluders; // Local space, owned by AssetManager
 
-	Drawable() { }
+	Drawable() : StaticBVH(nullptr), Occluders(nullptr) { }
 
-	Drawable(const VertexArrayObject& vaos, const Material& material)
-		: VAOs(std::vector<VertexArrayObject>() = { vaos }), Materials(std::vector<Material>() = { material }) { }
+	Drawable(const VertexArrayObject& vaos, MaterialID material)
+		: VAOs(std::vector<VertexArrayObject>() = { vaos }), Materials(std::vector<MaterialID>() = { material }), StaticBVH(nullptr), Occluders(nullptr) { }
 
-	Drawable(const std::vector<VertexArrayObject>& vaos, const std::vector<Material>& materials)
-		: VAOs(vaos), Materials(materials) { }
-	
-	void draw(const glm::mat4& viewProjection) const
-	{
-		for (int i = 0; i < VAOs.size(); i++)
-		{
-			const VertexArrayObject& vao = VAOs.at(i);
-			const Material& material = Materials.at(i);
-
-			vao.bind();
-			material.useShader();
-			material.setMaterialUniforms();
-			material.bind();
-			updateShaderUniforms(material.getShader(), viewProjection);
-			vao.draw();
-		}
-	}
-
-protected:
-	virtual void updateShaderUniforms(const Shader& shader, const glm::mat4& viewProjection) const = 0;
-};
\ No newline at end of file
+	Drawable(const std::vector<VertexArrayObject>& vaos, const std::vector<MaterialID>& materials)
+		: VAOs(vaos), Materials(materials), StaticBVH(nullptr), Occluders(nullptr) { }
+};
@@ -0,0 +1,16 @@
+// Mirrors GPUDrawItem and GPUMeshRange in gpuculler.h (std430)
+struct DrawItem
+{
+    mat4 model;
+    vec4 boundsCenter;  // World space AABB
+    vec4 boundsExtents;
+    uint mesh;
+    uint materialIndex;
+    uint group;
+    uint padding;
+};
+
+layout (std430, binding = 3) readonly buffer DrawItemBlock
+{
+    DrawItem u_drawItems[];
+};
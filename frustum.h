@@ -0,0 +1,202 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+#include "bounds.h"
+
+// Planes point inwards and are normalized, so dot(Normal, p) + Distance is a signed distance
+struct Frustum
+{
+	enum Side { Left = 0, Right, Bottom, Top, Near, Far, Count };
+
+	glm::vec4 Planes[Count];
+
+	// Gribb/Hartmann extraction, works for perspective and orthographic projections alike
+	static Frustum fromMatrix(const glm::mat4& viewProjection)
+	{
+		glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		Frustum frustum;
+		frustum.Planes[Left] = row3 + row0;
+		frustum.Planes[Right] = row3 - row0;
+		frustum.Planes[Bottom] = row3 + row1;
+		frustum.Planes[Top] = row3 - row1;
+		frustum.Planes[Near] = row3 + row2;
+		frustum.Planes[Far] = row3 - row2;
+
+		for (glm::vec4& plane : frustum.Planes)
+			plane /= glm::length(glm::vec3(plane));
+
+		return frustum;
+	}
+};
+
+struct FrustumCullStats
+{
+	unsigned int Tested;
+	unsigned int Culled;
+};
+
+// Collects world space bounds as structure of arrays and tests them four at a time.
+// A bound is rejected when it lies fully behind any plane, using the smaller of the box's
+// projected extent and the sphere radius. Results stay valid until the next begin().
+class FrustumCuller
+{
+public:
+	FrustumCullStats Stats;
+
+	FrustumCuller()
+	{
+		Stats = FrustumCullStats();
+		count = 0;
+	}
+
+	void begin(const glm::mat4& viewProjection)
+	{
+		frustum = Frustum::fromMatrix(viewProjection);
+		count = 0;
+		centerX.clear(); centerY.clear(); centerZ.clear();
+		extentX.clear(); extentY.clear(); extentZ.clear();
+		radius.clear();
+		visible.clear();
+		Stats = FrustumCullStats();
+	}
+
+	uint32_t add(const Bounds& bounds)
+	{
+		centerX.push_back(bounds.Center.x);
+		centerY.push_back(bounds.Center.y);
+		centerZ.push_back(bounds.Center.z);
+		extentX.push_back(bounds.Extents.x);
+		extentY.push_back(bounds.Extents.y);
+		extentZ.push_back(bounds.Extents.z);
+		radius.push_back(bounds.Radius);
+		return count++;
+	}
+
+	void cull()
+	{
+		// Pad to a whole number of lanes, the padding results are never read
+		size_t padded = (count + 3) & ~size_t(3);
+		centerX.resize(padded); centerY.resize(padded); centerZ.resize(padded);
+		extentX.resize(padded); extentY.resize(padded); extentZ.resize(padded);
+		radius.resize(padded);
+		visible.resize(padded);
+
+#ifdef FRUSTUM_SSE
+		cullSSE(padded);
+#else
+		cullScalar(padded);
+#endif
+
+		Stats.Tested = count;
+		Stats.Culled = 0;
+		for (uint32_t i = 0; i < count; i++)
+			Stats.Culled += visible[i] ? 0 : 1;
+	}
+
+	bool isVisible(uint32_t index) const
+	{
+		return visible[index] != 0;
+	}
+
+	Bounds getBounds(uint32_t index) const
+	{
+		Bounds bounds;
+		bounds.Center = glm::vec3(centerX[index], centerY[index], centerZ[index]);
+		bounds.Extents = glm::vec3(extentX[index], extentY[index], extentZ[index]);
+		bounds.Radius = radius[index];
+		return bounds;
+	}
+
+	const Frustum& getFrustum() const
+	{
+		return frustum;
+	}
+
+private:
+	Frustum frustum;
+	uint32_t count;
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+	std::vector<uint8_t> visible;
+
+#ifdef FRUSTUM_SSE
+	void cullSSE(size_t padded)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+
+		__m128 planeX[Frustum::Count], planeY[Frustum::Count], planeZ[Frustum::Count], planeW[Frustum::Count];
+		__m128 absX[Frustum::Count], absY[Frustum::Count], absZ[Frustum::Count];
+		for (int p = 0; p < Frustum::Count; p++)
+		{
+			planeX[p] = _mm_set1_ps(frustum.Planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.Planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.Planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.Planes[p].w);
+			absX[p] = _mm_andnot_ps(signMask, planeX[p]);
+			absY[p] = _mm_andnot_ps(signMask, planeY[p]);
+			absZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+		}
+
+		for (size_t i = 0; i < padded; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&centerX[i]);
+			__m128 cy = _mm_loadu_ps(&centerY[i]);
+			__m128 cz = _mm_loadu_ps(&centerZ[i]);
+			__m128 ex = _mm_loadu_ps(&extentX[i]);
+			__m128 ey = _mm_loadu_ps(&extentY[i]);
+			__m128 ez = _mm_loadu_ps(&extentZ[i]);
+			__m128 r = _mm_loadu_ps(&radius[i]);
+
+			__m128 outside = zero;
+			for (int p = 0; p < Frustum::Count; p++)
+			{
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(cx, planeX[p]), _mm_mul_ps(cy, planeY[p])),
+					_mm_add_ps(_mm_mul_ps(cz, planeZ[p]), planeW[p]));
+				__m128 boxRadius = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(ex, absX[p]), _mm_mul_ps(ey, absY[p])),
+					_mm_mul_ps(ez, absZ[p]));
+				__m128 reach = _mm_min_ps(boxRadius, r);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+			}
+
+			int outsideBits = _mm_movemask_ps(outside);
+			visible[i + 0] = (outsideBits & 1) == 0;
+			visible[i + 1] = (outsideBits & 2) == 0;
+			visible[i + 2] = (outsideBits & 4) == 0;
+			visible[i + 3] = (outsideBits & 8) == 0;
+		}
+	}
+#else
+	void cullScalar(size_t padded)
+	{
+		for (size_t i = 0; i < padded; i++)
+		{
+			bool outside = false;
+			for (int p = 0; p < Frustum::Count && !outside; p++)
+			{
+				const glm::vec4& plane = frustum.Planes[p];
+				float distance = centerX[i] * plane.x + centerY[i] * plane.y + centerZ[i] * plane.z + plane.w;
+				float boxRadius = extentX[i] * glm::abs(plane.x) + extentY[i] * glm::abs(plane.y) + extentZ[i] * glm::abs(plane.z);
+				outside = distance + glm::min(boxRadius, radius[i]) < 0.0f;
+			}
+			visible[i] = !outside;
+		}
+	}
+#endif
+};
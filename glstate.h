@@ -0,0 +1,244 @@
+#pragma once
+#include <GL/glew.h>
+
+// Shadows the GL binding state that the renderer touches and drops calls that would not change it.
+// Everything that binds programs, VAOs, textures or toggles the tracked capabilities must go through
+// here, otherwise the cache goes stale. Call invalidate() after handing the context to foreign code.
+struct GLStateStats
+{
+	unsigned int Issued;
+	unsigned int Elided;
+};
+
+class GLState
+{
+public:
+	static const int MaxTextureUnits = 16;
+
+	GLStateStats LastFrame;
+
+	static GLState& getInstance()
+	{
+		static GLState instance;
+		return instance;
+	}
+
+	void beginFrame()
+	{
+		LastFrame = current;
+		current = GLStateStats();
+	}
+
+	const GLStateStats& getFrameStats() const
+	{
+		return current;
+	}
+
+	void invalidate()
+	{
+		program = Unknown;
+		vao = Unknown;
+		activeUnit = Unknown;
+		for (int unit = 0; unit < MaxTextureUnits; unit++)
+		{
+			for (int target = 0; target < TargetCount; target++)
+				textures[unit][target] = Unknown;
+			samplers[unit] = Unknown;
+		}
+		depthMask = Unknown;
+		colorMask = Unknown;
+		depthTest = Unknown;
+		depthFunc = Unknown;
+		blend = Unknown;
+		blendSrc = Unknown;
+		blendDst = Unknown;
+		cullFace = Unknown;
+	}
+
+	void useProgram(unsigned int id)
+	{
+		if (track(program, id))
+			glUseProgram(id);
+	}
+
+	void bindVertexArray(unsigned int id)
+	{
+		if (track(vao, id))
+			glBindVertexArray(id);
+	}
+
+	// Units past the cache are not tracked and always reach GL
+	void bindTexture(unsigned int unit, GLenum target, unsigned int id)
+	{
+		if (unit >= MaxTextureUnits)
+		{
+			current.Issued++;
+			setActiveTexture(unit);
+			glBindTexture(target, id);
+		}
+		else if (track(textures[unit][targetIndex(target)], id))
+		{
+			setActiveTexture(unit);
+			glBindTexture(target, id);
+		}
+	}
+
+	// GL unbinds a deleted texture from every unit it was bound to, and the name may come straight
+	// back from the next glGenTextures, so the cache has to forget it too
+	void deleteTexture(unsigned int id)
+	{
+		for (int unit = 0; unit < MaxTextureUnits; unit++)
+		{
+			for (int target = 0; target < TargetCount; target++)
+			{
+				if (textures[unit][target] == id)
+					textures[unit][target] = 0;
+			}
+		}
+		glDeleteTextures(1, &id);
+	}
+
+	void bindSampler(unsigned int unit, unsigned int id)
+	{
+		if (unit >= MaxTextureUnits)
+		{
+			current.Issued++;
+			glBindSampler(unit, id);
+		}
+		else if (track(samplers[unit], id))
+			glBindSampler(unit, id);
+	}
+
+	void setDepthMask(bool enabled)
+	{
+		if (track(depthMask, enabled))
+			glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	}
+
+	void setDepthTest(bool enabled)
+	{
+		if (track(depthTest, enabled))
+			setCapability(GL_DEPTH_TEST, enabled);
+	}
+
+	void setDepthFunc(GLenum func)
+	{
+		if (track(depthFunc, func))
+			glDepthFunc(func);
+	}
+
+	void setBlend(bool enabled)
+	{
+		if (track(blend, enabled))
+			setCapability(GL_BLEND, enabled);
+	}
+
+	void setBlendFunc(GLenum src, GLenum dst)
+	{
+		if (blendSrc == src && blendDst == dst)
+		{
+			current.Elided++;
+			return;
+		}
+
+		blendSrc = src;
+		blendDst = dst;
+		current.Issued++;
+		glBlendFunc(src, dst);
+	}
+
+	// Per draw buffer functions leave the global one unknown
+	void setBlendFunci(unsigned int buffer, GLenum src, GLenum dst)
+	{
+		blendSrc = Unknown;
+		blendDst = Unknown;
+		current.Issued++;
+		glBlendFunci(buffer, src, dst);
+	}
+
+	void setColorMask(bool enabled)
+	{
+		if (track(colorMask, enabled))
+		{
+			GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+			glColorMask(mask, mask, mask, mask);
+		}
+	}
+
+	void setCullFace(bool enabled)
+	{
+		if (track(cullFace, enabled))
+			setCapability(GL_CULL_FACE, enabled);
+	}
+
+private:
+	static const unsigned int Unknown = 0xFFFFFFFF;
+	static const int TargetCount = 3;
+
+	GLStateStats current;
+
+	unsigned int program;
+	unsigned int vao;
+	unsigned int activeUnit;
+	unsigned int textures[MaxTextureUnits][TargetCount];
+	unsigned int samplers[MaxTextureUnits];
+	unsigned int depthMask;
+	unsigned int colorMask;
+	unsigned int depthTest;
+	unsigned int depthFunc;
+	unsigned int blend;
+	unsigned int blendSrc;
+	unsigned int blendDst;
+	unsigned int cullFace;
+
+	GLState()
+	{
+		LastFrame = GLStateStats();
+		current = GLStateStats();
+		invalidate();
+	}
+
+	bool track(unsigned int& cached, unsigned int value)
+	{
+		if (cached == value)
+		{
+			current.Elided++;
+			return false;
+		}
+
+		cached = value;
+		current.Issued++;
+		return true;
+	}
+
+	void setActiveTexture(unsigned int unit)
+	{
+		if (activeUnit != unit)
+		{
+			activeUnit = unit;
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+	}
+
+	void setCapability(GLenum capability, bool enabled)
+	{
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+	}
+
+	int targetIndex(GLenum target) const
+	{
+		if (target == GL_TEXTURE_CUBE_MAP)
+			return 1;
+		else if (target == GL_TEXTURE_2D_ARRAY)
+			return 2;
+		else
+			return 0;
+	}
+
+public:
+	GLState(GLState const&) = delete;
+	void operator=(GLState const&) = delete;
+};
@@ -0,0 +1,408 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "drawable.h"
+#include "frustum.h"
+#include "glstate.h"
+#include "meshpool.h"
+#include "shadermanager.h"
+
+// Mirrors DrawItem in drawitems.glsl (std430, 112 byte stride)
+struct GPUDrawItem
+{
+	glm::mat4 Model;
+	glm::vec4 BoundsCenter;
+	glm::vec4 BoundsExtents;
+	uint32_t Mesh;
+	uint32_t MaterialIndex;
+	uint32_t Group;
+	uint32_t Padding;
+};
+
+// Layout fixed by glMultiDrawElementsIndirect
+struct GPUDrawCommand
+{
+	uint32_t Count;
+	uint32_t InstanceCount;
+	uint32_t FirstIndex;
+	int32_t BaseVertex;
+	uint32_t BaseInstance;
+};
+
+// GPU-driven path for large object counts. Every submesh becomes a draw item in an SSBO and
+// gpuCulling.comp frustum and hi-Z tests them all in one dispatch, appending the survivors to a
+// compacted indirect command buffer. Items are grouped by program, each group is one
+// glMultiDrawElementsIndirectCountARB, whatever the number of objects.
+// Only opaque materials that need no per-draw texture binds qualify: untextured ones, or
+// textured ones batched by the MaterialTable. Everything else stays on the RenderQueue.
+// Only core GL 4.3 is required, ARB_indirect_parameters is used when present, so the path also
+// runs on software implementations such as llvmpipe.
+class GPUCuller
+{
+public:
+	static const uint32_t InvalidHandle = 0xFFFFFFFF;
+	static const int ItemBinding = 3;
+	static const int MeshBinding = 4;
+	static const int CommandBinding = 5;
+	static const int CounterBinding = 6;
+	static const int GroupBinding = 7;
+	static const int WorkGroupSize = 64;
+
+	bool OcclusionCulling;
+
+	GPUCuller()
+	{
+		OcclusionCulling = true;
+		built = false;
+		itemBuffer = meshBuffer = commandBuffer = counterBuffer = groupBuffer = 0;
+		depthTexture = depthFramebuffer = pyramidTexture = 0;
+		depthWidth = depthHeight = 0;
+		pyramidWidth = pyramidHeight = pyramidLevels = 0;
+		pyramidViewProjection = glm::mat4(1.0f);
+		dirtyBegin = dirtyEnd = 0;
+	}
+
+	static bool isSupported()
+	{
+		return GLEW_VERSION_4_3 != 0;
+	}
+
+	bool isBuilt() const
+	{
+		return built;
+	}
+
+	// Registers every submesh of the drawable, or none of them when any cannot be drawn this way
+	uint32_t add(const Drawable& drawable)
+	{
+		MaterialLibrary& library = MaterialLibrary::getInstance();
+		for (MaterialID id : drawable.Materials)
+		{
+			if (!isEligible(library.get(id)))
+				return InvalidHandle;
+		}
+
+		uint32_t handle = (uint32_t)objects.size();
+		objects.push_back({ (uint32_t)items.size(), (uint32_t)drawable.VAOs.size() });
+
+		for (size_t i = 0; i < drawable.VAOs.size(); i++)
+		{
+			const Material& material = library.get(drawable.Materials[i]);
+
+			GPUDrawItem item = GPUDrawItem();
+			item.Model = glm::mat4(1.0f);
+			item.Mesh = meshPool.add(drawable.VAOs[i]);
+			item.MaterialIndex = material.ID;
+			item.Group = getGroup(material.getShader().Keywords | ShaderKeyword::IndirectDraw);
+
+			items.push_back(item);
+			localBounds.push_back(drawable.VAOs[i].LocalBounds);
+			groups[item.Group].capacity++;
+		}
+
+		return handle;
+	}
+
+	void build()
+	{
+		if (items.empty())
+			return;
+
+		meshPool.build((uint32_t)items.size());
+
+		std::vector<uint32_t> groupOffsets;
+		uint32_t offset = 0;
+		for (Group& group : groups)
+		{
+			group.offset = offset;
+			groupOffsets.push_back(offset);
+			offset += group.capacity;
+		}
+
+		itemBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, items.size() * sizeof(GPUDrawItem), items.data(), GL_DYNAMIC_DRAW);
+		meshBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, meshPool.Meshes.size() * sizeof(GPUMeshRange), meshPool.Meshes.data(), GL_STATIC_DRAW);
+		groupBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, groupOffsets.size() * sizeof(uint32_t), groupOffsets.data(), GL_STATIC_DRAW);
+		commandBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, items.size() * sizeof(GPUDrawCommand), NULL, GL_DYNAMIC_COPY);
+		counterBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, groups.size() * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+
+		cullShader = Shader::compute("gpuCulling.comp");
+		pyramidShader = Shader::compute("depthPyramid.comp");
+		dirtyBegin = dirtyEnd = 0; // The whole array just went up
+		built = true;
+	}
+
+	// Only the items touched since the last cull() are uploaded, so set just what moved
+	void setTransform(uint32_t handle, const glm::mat4& model)
+	{
+		const Object& object = objects[handle];
+		if (dirtyBegin == dirtyEnd)
+		{
+			dirtyBegin = object.firstItem;
+			dirtyEnd = object.firstItem + object.itemCount;
+		}
+		else
+		{
+			dirtyBegin = std::min(dirtyBegin, object.firstItem);
+			dirtyEnd = std::max(dirtyEnd, object.firstItem + object.itemCount);
+		}
+
+		for (uint32_t i = 0; i < object.itemCount; i++)
+		{
+			GPUDrawItem& item = items[object.firstItem + i];
+			Bounds bounds = localBounds[object.firstItem + i].transformed(model);
+			item.Model = model;
+			item.BoundsCenter = glm::vec4(bounds.Center, 0.0f);
+			item.BoundsExtents = glm::vec4(bounds.Extents, 0.0f);
+		}
+	}
+
+	// One upload of the changed item range and one dispatch for all items
+	void cull(const glm::mat4& viewProjection)
+	{
+		if (!built)
+			return;
+
+		if (dirtyEnd > dirtyBegin)
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, itemBuffer);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyBegin * sizeof(GPUDrawItem), (dirtyEnd - dirtyBegin) * sizeof(GPUDrawItem), &items[dirtyBegin]);
+			dirtyBegin = dirtyEnd = 0;
+		}
+
+		uint32_t zero = 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+		// Without a GPU-side draw count every slot is drawn, unwritten ones must be empty commands
+		if (!GLEW_ARB_indirect_parameters)
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+			glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		}
+
+		bindBuffers();
+
+		Frustum frustum = Frustum::fromMatrix(viewProjection);
+		bool occlusion = OcclusionCulling && pyramidTexture != 0;
+
+		cullShader.use();
+		glUniform4fv(0, Frustum::Count, glm::value_ptr(frustum.Planes[0]));
+		glUniformMatrix4fv(6, 1, GL_FALSE, glm::value_ptr(pyramidViewProjection));
+		glUniform1ui(7, (GLuint)items.size());
+		glUniform2f(8, (float)pyramidWidth, (float)pyramidHeight);
+		glUniform1i(9, pyramidLevels);
+		glUniform1i(10, occlusion ? 1 : 0);
+		if (occlusion)
+			GLState::getInstance().bindTexture(0, GL_TEXTURE_2D, pyramidTexture);
+
+		glDispatchCompute((GLuint)((items.size() + WorkGroupSize - 1) / WorkGroupSize), 1, 1);
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	// One multi-draw per group. Groups whose program is still compiling are skipped.
+	void draw(const glm::mat4& viewProjection)
+	{
+		if (!built)
+			return;
+
+		ShaderManager& shaderManager = ShaderManager::getInstance();
+		meshPool.bind();
+		bindBuffers();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		if (GLEW_ARB_indirect_parameters)
+			glBindBuffer(GL_PARAMETER_BUFFER_ARB, counterBuffer);
+
+		for (size_t i = 0; i < groups.size(); i++)
+		{
+			const Group& group = groups[i];
+			if (!shaderManager.isReady(group.shader))
+				continue;
+
+			group.shader.use();
+			group.shader.setMat4(UniformLocation::ViewProjection, viewProjection);
+
+			const void* commands = (const void*)(group.offset * sizeof(GPUDrawCommand));
+			if (GLEW_ARB_indirect_parameters)
+				glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, commands, (GLintptr)(i * sizeof(uint32_t)), group.capacity, 0);
+			else
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, group.capacity, 0);
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	// Copies the finished frame's depth and reduces it into the hi-Z pyramid used by the next cull().
+	// Sized after the current viewport. The blit needs the default framebuffer to have a 24 bit
+	// depth, 8 bit stencil format.
+	void captureDepth(const glm::mat4& viewProjection)
+	{
+		if (!built || !OcclusionCulling)
+			return;
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		int width = viewport[2];
+		int height = viewport[3];
+		if (width != depthWidth || height != depthHeight)
+			createDepthTargets(width, height);
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFramebuffer);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		GLState& glState = GLState::getInstance();
+		pyramidShader.use();
+
+		int sourceWidth = width;
+		int sourceHeight = height;
+		for (int level = 0; level < pyramidLevels; level++)
+		{
+			int levelWidth = std::max(1, pyramidWidth >> level);
+			int levelHeight = std::max(1, pyramidHeight >> level);
+
+			glState.bindTexture(0, GL_TEXTURE_2D, level == 0 ? depthTexture : pyramidTexture);
+			glBindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			glUniform1i(0, level == 0 ? 0 : level - 1);
+			glUniform2i(1, sourceWidth, sourceHeight);
+			glUniform2i(2, levelWidth, levelHeight);
+			glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			sourceWidth = levelWidth;
+			sourceHeight = levelHeight;
+		}
+
+		pyramidViewProjection = viewProjection;
+	}
+
+	size_t getItemCount() const
+	{
+		return items.size();
+	}
+
+private:
+	struct Object
+	{
+		uint32_t firstItem;
+		uint32_t itemCount;
+	};
+
+	struct Group
+	{
+		Shader shader;
+		uint32_t offset;
+		uint32_t capacity;
+	};
+
+	bool built;
+	MeshPool meshPool;
+	std::vector<Object> objects;
+	std::vector<GPUDrawItem> items;
+	uint32_t dirtyBegin; // Items changed since the last upload, empty when equal
+	uint32_t dirtyEnd;
+	std::vector<Bounds> localBounds;
+	std::vector<Group> groups;
+	std::unordered_map<unsigned int, uint32_t> groupLookup;
+
+	Shader cullShader;
+	Shader pyramidShader;
+
+	unsigned int itemBuffer;
+	unsigned int meshBuffer;
+	unsigned int commandBuffer;
+	unsigned int counterBuffer;
+	unsigned int groupBuffer;
+
+	unsigned int depthTexture;
+	unsigned int depthFramebuffer;
+	unsigned int pyramidTexture;
+	int depthWidth, depthHeight;
+	int pyramidWidth, pyramidHeight, pyramidLevels;
+	glm::mat4 pyramidViewProjection;
+
+	static bool isEligible(const Material& material)
+	{
+		if (material.Pass != RenderPass::Opaque)
+			return false;
+
+		bool textured = material.getTextureID(TextureType::Diffuse) != 4096
+			|| material.getTextureID(TextureType::Normal) != 4096
+			|| material.getTextureID(TextureType::Specular) != 4096;
+		return material.Batched || !textured;
+	}
+
+	uint32_t getGroup(unsigned int keywords)
+	{
+		auto itr = groupLookup.find(keywords);
+		if (itr != groupLookup.end())
+			return itr->second;
+
+		uint32_t index = (uint32_t)groups.size();
+		groups.push_back({ ShaderManager::getInstance().getVariant(keywords), 0, 0 });
+		groupLookup.insert(std::make_pair(keywords, index));
+		return index;
+	}
+
+	static unsigned int createBuffer(GLenum target, size_t size, const void* data, GLenum usage)
+	{
+		unsigned int buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+		glBufferData(target, std::max(size, (size_t)4), data, usage);
+		return buffer;
+	}
+
+	void bindBuffers() const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ItemBinding, itemBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MeshBinding, meshBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandBinding, commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CounterBinding, counterBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GroupBinding, groupBuffer);
+	}
+
+	// Level 0 of the pyramid is half the depth resolution, each texel the max of the pixels it covers
+	void createDepthTargets(int width, int height)
+	{
+		GLState& glState = GLState::getInstance();
+		if (depthTexture != 0)
+		{
+			glDeleteFramebuffers(1, &depthFramebuffer);
+			glState.deleteTexture(depthTexture);
+			glState.deleteTexture(pyramidTexture);
+		}
+
+		depthWidth = width;
+		depthHeight = height;
+
+		glGenTextures(1, &depthTexture);
+		glState.bindTexture(0, GL_TEXTURE_2D, depthTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glGenFramebuffers(1, &depthFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		pyramidWidth = std::max(1, (width + 1) / 2);
+		pyramidHeight = std::max(1, (height + 1) / 2);
+		pyramidLevels = (int)std::floor(std::log2((float)std::max(pyramidWidth, pyramidHeight))) + 1;
+
+		glGenTextures(1, &pyramidTexture);
+		glState.bindTexture(0, GL_TEXTURE_2D, pyramidTexture);
+		glTexStorage2D(GL_TEXTURE_2D, pyramidLevels, GL_R32F, pyramidWidth, pyramidHeight);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+};
@@ -0,0 +1,15 @@
+// Mirrors GPUParticle in gpuparticlesystem.h (std430, 48 byte stride)
+struct Particle
+{
+    vec4 positionSize;
+    vec4 velocity; // w holds lifetime
+    float roll;
+    float rollSpeed;
+    float age;
+    float padding;
+};
+
+layout (std430, binding = 8) buffer ParticleBlock
+{
+    Particle u_particles[];
+};
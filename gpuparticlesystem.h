@@ -0,0 +1,210 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "assetmanager.h"
+#include "glstate.h"
+#include "gpuculler.h"
+#include "particlebillboard.h"
+#include "particlestore.h"
+#include "randomstream.h"
+#include "scenedepth.h"
+
+// Mirrors Particle in gpuparticles.glsl (std430, 48 byte stride)
+struct GPUParticle
+{
+	glm::vec4 PositionSize;
+	glm::vec4 Velocity; // w holds lifetime
+	float Roll;
+	float RollSpeed;
+	float Age;
+	float Padding;
+};
+
+// Mirrors StateBlock in gpuParticles.comp. Draw.InstanceCount doubles as the next alive count, so
+// the simulation leaves a ready indirect draw behind.
+struct GPUParticleState
+{
+	GPUDrawCommand Draw;
+	uint32_t AliveCount;
+	uint32_t DeadCount;
+	uint32_t EmitCount;
+	uint32_t EmitGroups[3];
+	uint32_t SimulateGroups[3];
+};
+
+// Emitter that lives entirely on the GPU. Every frame three compute passes run over the
+// particle SSBO: the kick sizes the work, emit pops the dead list into the alive list and
+// simulate ages the alive list into the next one, or back onto the dead list. The lists
+// ping-pong and the draw reads the survivors' count straight from the state buffer, so the
+// CPU cost per frame is a handful of calls whatever the particle count, with no readback.
+// Particles collide with the last SceneDepth capture, which must come from an earlier frame.
+// Defaults reproduce ParticleSystem's snow.
+class GPUParticleSystem
+{
+public:
+	static const int ParticleBinding = 8;
+	static const int AliveBinding = 9;
+	static const int NextAliveBinding = 10;
+	static const int DeadBinding = 11;
+	static const int StateBinding = 12;
+	static const int WorkGroupSize = 64;
+
+	glm::vec3 SpawnMin;
+	glm::vec3 SpawnMax;
+	glm::vec3 VelocityMin;
+	glm::vec3 VelocityMax;
+	float LifetimeMin;
+	float LifetimeMax;
+	float Size;
+	float RollSpeed; // Radians per second, in [-RollSpeed, RollSpeed]
+	uint32_t SpawnPerFrame; // Also bounded by the dead list
+	CollisionResponse Collision;
+	float CollisionThickness; // How far behind the scene depth particles still collide
+	ParticleBillboard Billboard;
+
+	static bool isSupported()
+	{
+		return GLEW_VERSION_4_3 != 0;
+	}
+
+	GPUParticleSystem(uint32_t capacity, uint64_t seed = 1)
+		: Billboard("#define GPU_PARTICLES\n")
+	{
+		SpawnMin = glm::vec3(2.0f, -4.0f, -12.0f);
+		SpawnMax = glm::vec3(10.0f, 4.0f, 0.0f);
+		VelocityMin = glm::vec3(-3.0f, -1.0f, 0.0f);
+		VelocityMax = glm::vec3(-1.0f, 0.0f, 2.0f);
+		LifetimeMin = 5.0f;
+		LifetimeMax = 10.0f;
+		Size = 0.1f;
+		RollSpeed = 0.25f;
+		// Expired flakes come back the next frame, keeping the population at capacity
+		SpawnPerFrame = capacity;
+		Collision = CollisionResponse::None;
+		CollisionThickness = 0.5f;
+
+		this->capacity = capacity;
+		this->seed = seed;
+		updateIndex = 0;
+
+		quad = AssetManager::getInstance().getVertexArrayObject("Quad");
+
+		kickShader = Shader::compute("gpuParticles.comp", "#define PARTICLE_KICK\n");
+		emitShader = Shader::compute("gpuParticles.comp", "#define PARTICLE_EMIT\n");
+		simulateShader = Shader::compute("gpuParticles.comp", "#define PARTICLE_SIMULATE\n");
+
+		// Everything starts dead and is emitted by the first update
+		std::vector<uint32_t> dead(capacity);
+		for (uint32_t i = 0; i < capacity; i++)
+			dead[i] = i;
+
+		GPUParticleState state = {};
+		state.Draw = { (uint32_t)quad.IndicesSize, 0, 0, 0, 0 };
+		state.DeadCount = capacity;
+
+		particleBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(GPUParticle), NULL, GL_DYNAMIC_COPY);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, NULL);
+		aliveBuffers[0] = createBuffer(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+		aliveBuffers[1] = createBuffer(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+		deadBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(uint32_t), dead.data(), GL_DYNAMIC_COPY);
+		stateBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(GPUParticleState), &state, GL_DYNAMIC_COPY);
+	}
+
+	// Only records GPU work, nothing waits on it
+	void update(float deltaTime)
+	{
+		if (capacity == 0)
+			return;
+
+		uint64_t update = updateIndex++;
+		int current = (int)(update & 1);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ParticleBinding, particleBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, AliveBinding, aliveBuffers[current]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NextAliveBinding, aliveBuffers[current ^ 1]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DeadBinding, deadBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, StateBinding, stateBuffer);
+
+		kickShader.use();
+		glUniform1ui(2, SpawnPerFrame);
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, stateBuffer);
+
+		emitShader.use();
+		glUniform1ui(1, (uint32_t)RandomStream::makeSeed(seed, update, 0));
+		glUniform3f(3, SpawnMin.x, SpawnMin.y, SpawnMin.z);
+		glUniform3f(4, SpawnMax.x, SpawnMax.y, SpawnMax.z);
+		glUniform3f(5, VelocityMin.x, VelocityMin.y, VelocityMin.z);
+		glUniform3f(6, VelocityMax.x, VelocityMax.y, VelocityMax.z);
+		glUniform2f(7, LifetimeMin, LifetimeMax);
+		glUniform1f(8, Size);
+		glUniform1f(9, RollSpeed);
+		glDispatchComputeIndirect(offsetof(GPUParticleState, EmitGroups));
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		SceneDepth& sceneDepth = SceneDepth::getInstance();
+		bool collides = Collision != CollisionResponse::None && sceneDepth.getTexture() != 0;
+
+		simulateShader.use();
+		glUniform1f(0, deltaTime);
+		glUniform1ui(18, collides ? (uint32_t)Collision : 0);
+		if (collides)
+		{
+			glm::mat4 viewProjection = sceneDepth.getProjection() * sceneDepth.getView();
+			glm::mat4 inverseProjection = glm::inverse(sceneDepth.getProjection());
+			glUniformMatrix4fv(10, 1, GL_FALSE, &viewProjection[0][0]);
+			glUniformMatrix4fv(14, 1, GL_FALSE, &inverseProjection[0][0]);
+			glUniform1f(19, CollisionThickness);
+			GLState::getInstance().bindTexture(0, GL_TEXTURE_2D, sceneDepth.getTexture());
+		}
+		glDispatchComputeIndirect(offsetof(GPUParticleState, SimulateGroups));
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	// One indirect draw of the last update's survivors
+	void draw(const glm::mat4& view, const glm::mat4& projection)
+	{
+		if (capacity == 0 || updateIndex == 0)
+			return;
+
+		int current = (int)((updateIndex - 1) & 1);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ParticleBinding, particleBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NextAliveBinding, aliveBuffers[current ^ 1]);
+
+		GLState::getInstance().bindVertexArray(quad.ID);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stateBuffer);
+		Billboard.begin(view, projection);
+		glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)offsetof(GPUParticleState, Draw));
+		Billboard.end();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+private:
+	VertexArrayObject quad;
+	Shader kickShader;
+	Shader emitShader;
+	Shader simulateShader;
+	unsigned int particleBuffer;
+	unsigned int aliveBuffers[2];
+	unsigned int deadBuffer;
+	unsigned int stateBuffer;
+	uint32_t capacity;
+	uint64_t seed;
+	uint64_t updateIndex;
+
+	static unsigned int createBuffer(GLenum target, size_t size, const void* data, GLenum usage)
+	{
+		unsigned int buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+		glBufferData(target, std::max(size, (size_t)4), data, usage);
+		return buffer;
+	}
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Top-down height map on a regular grid over the XZ plane, holding the highest surface above
+// each cell's centre, or NoSurface. Triangles are rasterized from above when baked, so a lookup
+// is a single load however detailed the geometry is. Surfaces facing sideways are missed and
+// anything under an overhang is hidden by it, which suits things falling from the sky.
+class HeightField
+{
+public:
+	static constexpr float NoSurface = -FLT_MAX;
+	static const int MaxCells = 1 << 22;
+
+	glm::vec2 Min; // x and z of the first cell's corner
+	float CellSize;
+	int Width; // Cells along x
+	int Depth; // Cells along z
+	std::vector<float> Heights; // Width * Depth, rows along x
+
+	HeightField()
+	{
+		Min = glm::vec2(0.0f);
+		CellSize = 1.0f;
+		Width = Depth = 0;
+	}
+
+	bool empty() const
+	{
+		return Heights.empty();
+	}
+
+	// Sizes the grid to the triangles' footprint. Cells grow past cellSize when the grid would
+	// go over MaxCells.
+	void build(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, float cellSize)
+	{
+		Heights.clear();
+		Width = Depth = 0;
+		if (indices.size() < 3)
+			return;
+
+		glm::vec2 min(FLT_MAX);
+		glm::vec2 max(-FLT_MAX);
+		for (uint32_t index : indices)
+		{
+			min = glm::min(min, glm::vec2(vertices[index].x, vertices[index].z));
+			max = glm::max(max, glm::vec2(vertices[index].x, vertices[index].z));
+		}
+
+		glm::vec2 extent = glm::max(max - min, glm::vec2(cellSize));
+		float cells = (extent.x / cellSize) * (extent.y / cellSize);
+		if (cells > (float)MaxCells)
+			cellSize *= std::sqrt(cells / (float)MaxCells);
+
+		Min = min;
+		CellSize = cellSize;
+		Width = (int)std::ceil(extent.x / cellSize);
+		Depth = (int)std::ceil(extent.y / cellSize);
+		Heights.assign((size_t)Width * Depth, NoSurface);
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			rasterize(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]]);
+	}
+
+	// NoSurface outside the grid
+	float sample(float x, float z) const
+	{
+		float cellX = (x - Min.x) / CellSize;
+		float cellZ = (z - Min.y) / CellSize;
+		if (!(cellX >= 0.0f && cellX < (float)Width && cellZ >= 0.0f && cellZ < (float)Depth))
+			return NoSurface;
+
+		return Heights[(size_t)cellZ * Width + (size_t)cellX];
+	}
+
+private:
+	// Keeps the highest point of the triangle over every cell centre it covers, either winding
+	void rasterize(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		float area = edge(a, b, c.x, c.z);
+		if (std::abs(area) < 1e-8f)
+			return;
+
+		float inverseArea = 1.0f / area;
+		int firstX = std::max((int)std::floor((std::min({ a.x, b.x, c.x }) - Min.x) / CellSize - 0.5f), 0);
+		int lastX = std::min((int)std::ceil((std::max({ a.x, b.x, c.x }) - Min.x) / CellSize - 0.5f), Width - 1);
+		int firstZ = std::max((int)std::floor((std::min({ a.z, b.z, c.z }) - Min.y) / CellSize - 0.5f), 0);
+		int lastZ = std::min((int)std::ceil((std::max({ a.z, b.z, c.z }) - Min.y) / CellSize - 0.5f), Depth - 1);
+
+		for (int cellZ = firstZ; cellZ <= lastZ; cellZ++)
+		{
+			float z = Min.y + (cellZ + 0.5f) * CellSize;
+			for (int cellX = firstX; cellX <= lastX; cellX++)
+			{
+				float x = Min.x + (cellX + 0.5f) * CellSize;
+				float u = edge(b, c, x, z) * inverseArea;
+				float v = edge(c, a, x, z) * inverseArea;
+				float w = 1.0f - u - v;
+				if (u < 0.0f || v < 0.0f || w < 0.0f)
+					continue;
+
+				float& height = Heights[(size_t)cellZ * Width + cellX];
+				height = std::max(height, u * a.y + v * b.y + w * c.y);
+			}
+		}
+	}
+
+	static float edge(const glm::vec3& from, const glm::vec3& to, float x, float z)
+	{
+		return (to.x - from.x) * (z - from.z) - (to.z - from.z) * (x - from.x);
+	}
+};
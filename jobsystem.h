@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Completion count of a group of jobs, see JobSystem::wait
+struct JobCounter
+{
+	std::atomic<uint32_t> Pending;
+
+	JobCounter() : Pending(0) { }
+};
+
+// Persistent worker threads fed from one shared queue. Work is dispatched as a number of indexed
+// jobs against a JobCounter. wait() runs queued jobs on the calling thread until the counter
+// drains, so the caller is never idle and any thread may wait without deadlocking the pool.
+class JobSystem
+{
+public:
+	using Job = std::function<void(uint32_t)>;
+
+	static JobSystem& getInstance()
+	{
+		static JobSystem instance;
+		return instance;
+	}
+
+	unsigned int getWorkerCount() const
+	{
+		return (unsigned int)workers.size();
+	}
+
+	// Runs job(index) for every index in [0, count). Whatever job captures must outlive wait().
+	void dispatch(uint32_t count, Job job, JobCounter& counter)
+	{
+		if (count == 0)
+			return;
+
+		std::shared_ptr<Job> shared = std::make_shared<Job>(std::move(job));
+		counter.Pending += count;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (uint32_t i = 0; i < count; i++)
+				queue.push_back({ shared, i, &counter });
+		}
+		wake.notify_all();
+	}
+
+	void wait(JobCounter& counter)
+	{
+		while (counter.Pending.load() != 0)
+		{
+			QueuedJob job;
+			if (tryPop(job))
+				run(job);
+			else
+				std::this_thread::yield();
+		}
+	}
+
+private:
+	struct QueuedJob
+	{
+		std::shared_ptr<Job> job;
+		uint32_t index;
+		JobCounter* counter;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<QueuedJob> queue;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping;
+
+	JobSystem()
+	{
+		stopping = false;
+
+		// One hardware thread is left to whoever waits, as it works through the queue too
+		unsigned int workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+		for (unsigned int i = 0; i < workerCount; i++)
+			workers.emplace_back([this]() { workerLoop(); });
+	}
+
+	~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	void workerLoop()
+	{
+		for (;;)
+		{
+			QueuedJob job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty())
+					return;
+
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+			run(job);
+		}
+	}
+
+	bool tryPop(QueuedJob& job)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (queue.empty())
+			return false;
+
+		job = std::move(queue.front());
+		queue.pop_front();
+		return true;
+	}
+
+	static void run(QueuedJob& job)
+	{
+		(*job.job)(job.index);
+		job.counter->Pending--;
+	}
+
+public:
+	JobSystem(JobSystem const&) = delete;
+	void operator=(JobSystem const&) = delete;
+};
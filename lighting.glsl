@@ -0,0 +1,143 @@
+struct DirLight
+{
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight
+{
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct SpotLight
+{
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    vec3 direction;
+    float cutoff;
+    float outerCutoff;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct Surface
+{
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    vec3 specular;
+    float shininess;
+};
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 1
+#endif
+
+// Structs take one location per member: u_dirLight 4-7, u_spotLight 8-17, u_pointLights 18+
+layout (location = 3) uniform vec3 u_viewPos;
+layout (location = 4) uniform DirLight u_dirLight;
+layout (location = 8) uniform SpotLight u_spotLight;
+layout (location = 18) uniform PointLight u_pointLights[NR_POINT_LIGHTS];
+
+float CalcAttenuation(float constant, float linear, float quadratic, vec3 lightPos, vec3 fragPos)
+{
+    float dist   = length(lightPos - fragPos);
+    float denom1 = constant;
+    float denom2 = linear * dist;
+    float denom3 = quadratic * dist * dist;
+    return 1.0 / (denom1 + denom2 + denom3);
+}
+
+vec3 CalcDirLight(DirLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+
+    // Ambient shading
+    vec3 ambient = light.ambient * surface.albedo;
+
+    // Diffuse shading
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+
+    // Specular shading
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float specAngle = max(dot(viewDir, reflectDir), 0.0);
+    float spec = pow(specAngle, surface.shininess);
+    vec3 specular = light.specular * spec * surface.specular;
+
+    return ambient + diffuse + specular;
+}
+
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+
+    // Ambient shading
+    vec3 ambient = light.ambient * surface.albedo;
+
+    // Diffuse shading
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+
+    // Specular shading
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+    vec3 specular = light.specular * spec * surface.specular;
+
+    float attenuation = CalcAttenuation(light.constant, light.linear, light.quadratic, light.position, surface.position);
+
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+
+    // Diffuse light
+    float diffuseAngle = max(dot(surface.normal, lightDir), 0.0);
+    vec3 diffuse = surface.albedo * light.diffuse * diffuseAngle;
+
+    // Specular light
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float specAngle = max(dot(viewDir, reflectDir), 0.0);
+    float spec = pow(specAngle, surface.shininess);
+    vec3 specular = surface.specular * light.specular * spec;
+
+    float attenuation = CalcAttenuation(light.constant, light.linear, light.quadratic, light.position, surface.position);
+
+    // Intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutoff - light.outerCutoff;
+    float intensity = clamp((theta - light.outerCutoff) / epsilon, 0.0, 1.0);
+
+    return (diffuse + specular) * attenuation * intensity;
+}
+
+vec3 CalcLighting(Surface surface)
+{
+    vec3 viewDir = normalize(u_viewPos - surface.position);
+    vec3 result = CalcDirLight(u_dirLight, surface, viewDir);
+
+    for (int i = 0; i < NR_POINT_LIGHTS; i++)
+        result += CalcPointLight(u_pointLights[i], surface, viewDir);
+
+    result += CalcSpotLight(u_spotLight, surface, viewDir);
+    return result;
+}
@@ -0,0 +1,83 @@
+#version 430
+#include "material.glsl"
+#include "lighting.glsl"
+
+// Permutations, see ShaderKeyword:
+//   DIFFUSE_MAP, NORMAL_MAP, SPECULAR_MAP  sample the map instead of the material parameter
+//   UNLIT                                  flat white, no lighting
+//   BATCHED_TEXTURES, BINDLESS_TEXTURES    fetch maps through the MaterialTable
+//   INDIRECT_DRAW                          transform and material come from the GPUCuller's draw items
+//   ALPHA_TEST                             discard below ALPHA_CUTOFF, for RenderPass::AlphaTested
+//   WEIGHTED_OIT                           write to WeightedBlendedOIT's targets instead of blending
+
+layout (location = 0) in vec3 WorldPos;
+layout (location = 1) in vec2 TexCoords;
+#ifdef NORMAL_MAP
+layout (location = 2) in mat3 TBN;
+#else
+layout (location = 2) in vec3 Normal;
+#endif
+
+#ifdef WEIGHTED_OIT
+layout (location = 0) out vec4 accumulation;
+layout (location = 1) out float revealage;
+#else
+layout (location = 0) out vec4 fragColor;
+#endif
+
+#define ALPHA_CUTOFF 0.5
+
+void main()
+{
+#ifdef UNLIT
+    vec4 color = vec4(1.0);
+#else
+    MaterialParams params = u_materialParams[u_materialIndex];
+    float alpha = params.diffuse.a;
+
+#ifdef DIFFUSE_MAP
+    vec4 albedo = sampleDiffuseMap(TexCoords);
+    alpha *= albedo.a;
+#endif
+
+#ifdef ALPHA_TEST
+    // map_d is taken to be the diffuse map's alpha, see AssetManager
+    if (alpha < ALPHA_CUTOFF)
+        discard;
+#endif
+
+    Surface surface;
+    surface.position = WorldPos;
+    surface.shininess = params.specular.w;
+
+#ifdef NORMAL_MAP
+    vec3 norm = sampleNormalMap(TexCoords).rgb * 2.0 - 1.0;
+    surface.normal = normalize(TBN * norm);
+#else
+    surface.normal = normalize(Normal);
+#endif
+
+#ifdef DIFFUSE_MAP
+    surface.albedo = albedo.rgb;
+#else
+    surface.albedo = params.diffuse.rgb;
+#endif
+
+#ifdef SPECULAR_MAP
+    surface.specular = sampleSpecularMap(TexCoords).rgb;
+#else
+    surface.specular = params.specular.rgb;
+#endif
+
+    vec4 color = vec4(CalcLighting(surface), alpha);
+#endif
+
+#ifdef WEIGHTED_OIT
+    // Weight function (10) from McGuire and Bavoil 2013, favours near and opaque surfaces
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    accumulation = vec4(color.rgb * color.a, color.a) * weight;
+    revealage = color.a;
+#else
+    fragColor = color;
+#endif
+}
@@ -0,0 +1,54 @@
+#version 430
+layout (location = 0) in vec3 v_position;
+layout (location = 1) in vec3 v_normal;
+layout (location = 2) in vec2 v_texCoords;
+layout (location = 3) in vec3 v_tangent;
+
+layout (location = 0) out vec3 WorldPos;
+layout (location = 1) out vec2 TexCoords;
+#ifdef NORMAL_MAP
+layout (location = 2) out mat3 TBN;
+#else
+layout (location = 2) out vec3 Normal;
+#endif
+
+// Explicit uniform locations, C++ sets them through UniformLocation in shader.h
+#ifdef INDIRECT_DRAW
+#include "drawitems.glsl"
+
+// Per instance, the draw's baseInstance is its slot in u_drawItems, see GPUCuller
+layout (location = 4) in uint v_drawIndex;
+layout (location = 5) flat out int MaterialIndex;
+
+layout (location = 1) uniform mat4 u_viewProjection;
+#else
+layout (location = 0) uniform mat4 u_model;
+layout (location = 1) uniform mat4 u_localToClip;
+#endif
+
+// Bit-identical to depthOnly.vert so a depth pre-pass can be followed by a GL_EQUAL lit pass
+invariant gl_Position;
+
+void main()
+{
+#ifdef INDIRECT_DRAW
+    mat4 u_model = u_drawItems[v_drawIndex].model;
+    MaterialIndex = int(u_drawItems[v_drawIndex].materialIndex);
+    gl_Position = u_viewProjection * u_model * vec4(v_position, 1.0);
+#else
+    gl_Position = u_localToClip * vec4(v_position, 1.0);
+#endif
+
+    WorldPos = vec3(u_model * vec4(v_position, 1.0));
+    TexCoords = v_texCoords;
+
+#ifdef NORMAL_MAP
+    vec3 T = normalize(vec3(u_model * vec4(v_tangent, 0.0)));
+    vec3 N = normalize(vec3(u_model * vec4(v_normal,  0.0)));
+    vec3 B = cross(N, T);
+
+    TBN = mat3(T, B, N);
+#else
+    Normal = mat3(transpose(inverse(u_model))) * v_normal;
+#endif
+}
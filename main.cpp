@@ -8,7 +8,7 @@
 #include <string>
 #include <fstream>
 
-#include "gameObject.h"
+#include "world.h"
 #include "pointlight.h"
 #include "directionallight.h"
 #include "helpers.h"
@@ -16,19 +16,41 @@
 #include "assetmanager.h"
 #include "shadermanager.h"
 #include "particlesystem.h"
+#include "gpuparticlesystem.h"
+#include "renderqueue.h"
+#include "glstate.h"
+#include "materialtable.h"
+#include "occlusionculler.h"
+#include "gpuculler.h"
+#include "jobsystem.h"
+#include "scenedepth.h"
+#include "benchmarks.h"
 
 #define WIDTH 1280
 #define HEIGHT 720
+#define MATERIAL_BATCH_MODE MaterialBatchMode::Disabled
+#define GPU_DRIVEN_CULLING false
+#define DEPTH_PRE_PASS true
+#define TRANSPARENCY_MODE TransparencyMode::Sorted
+#define GPU_PARTICLES false
+#define WEATHER_VOLUME true
+#define RUN_BENCHMARKS false
 
 Shader unlitShader;
 Shader mainShader;
 
-ParticleSystem* snowParticles;
-std::vector<GameObject> gameObjects;
+ParticleSystem* snowParticles = nullptr;
+GPUParticleSystem* gpuSnowParticles = nullptr;
+World world;
+Entity sceneRoot; // The snow's height field is baked in its space and follows it
+RenderQueue renderQueue;
+OcclusionCuller occlusionCuller;
+GPUCuller gpuCuller;
 
 // Lights
 DirectionalLight directionalLight;
 std::vector<PointLight> pointLights;
+std::vector<Entity> pointLightEntities; // Placed in the world, their positions are copied over every frame
 SpotLight spotLight;
 
 Camera* perspectiveCamera = new CameraPerspective((float)WIDTH / (float)HEIGHT, glm::vec3(0, 0, 5.0f));
@@ -42,6 +64,9 @@ void init(GLFWwindow* window)
 	unlitShader = shaderManager.getShader("UnlitShader");
 	mainShader = shaderManager.getShader("TexturedShader");
 
+	// Opt-in: textured materials share one program through bindless handles or texture arrays
+	MaterialTable::getInstance().enable(MATERIAL_BATCH_MODE);
+
 	// Load assets
 	AssetManager& assetManager = AssetManager::getInstance();
 
@@ -49,62 +74,165 @@ void init(GLFWwindow* window)
 	Material lightMaterial;
 	lightMaterial.setShader(unlitShader);
 
-	GameObject scene = assetManager.getGameObject("scene");
-	for (Material& mat : scene.Materials)
-		mat.Shininess = 1.0f;
-	gameObjects.push_back(scene);
+	// Opt-in: entities the GPUCuller accepts are culled and drawn by compute and indirect draws
+	bool gpuCulled = GPU_DRIVEN_CULLING && GPUCuller::isSupported();
+
+	const Drawable& scene = assetManager.getDrawable("scene");
+	for (MaterialID mat : scene.Materials)
+	{
+		Material material = MaterialLibrary::getInstance().get(mat);
+		material.Shininess = 1.0f;
+		MaterialLibrary::getInstance().set(mat, material);
+	}
+	sceneRoot = world.instantiate(scene, glm::vec3(0.0f), gpuCulled ? Component::GPUCulled : 0);
+
+	// The lamps' lights hang off the scene, so they follow it wherever it is moved
+	const glm::vec3 lampPositions[] =
+	{
+		glm::vec3(-1.385f, 2.267f, 3.076f),
+		glm::vec3(-2.403f, 2.268f, 4.278f),
+		glm::vec3(-3.9951f, 2.3591f, 6.4063f)
+	};
+	for (const glm::vec3& lampPosition : lampPositions)
+	{
+		Entity light = world.create(Component::Transform);
+		EntityRef ref = world.get(light);
+		ref.Table->Positions[ref.Row] = lampPosition;
+		world.setParent(light, sceneRoot);
+
+		PointLight pointLight;
+		pointLight.Position = lampPosition;
+		pointLights.push_back(pointLight);
+		pointLightEntities.push_back(light);
+	}
 
-	PointLight pointLight;
-	pointLight.Position = glm::vec3(-1.385f, 2.267f, 3.076f);
-	pointLights.push_back(pointLight);
-	pointLight.Position = glm::vec3(-2.403f, 2.268f, 4.278f);
-	pointLights.push_back(pointLight);
-	pointLight.Position = glm::vec3(-3.9951f, 2.3591f, 6.4063f);
-	pointLights.push_back(pointLight);
+	// Opt-in: snow is spawned, simulated and counted by compute shaders
+	if (GPU_PARTICLES && GPUParticleSystem::isSupported())
+	{
+		gpuSnowParticles = new GPUParticleSystem(100);
+		gpuSnowParticles->Collision = CollisionResponse::Stick;
+	}
+	else
+	{
+		// The weather volume around the camera is four times the fixed box, keep the density
+		int snowCount = WEATHER_VOLUME ? 400 : 100;
+
+		// Fill the pool at once, then replace flakes about as fast as they expire
+		snowParticles = new ParticleSystem(snowCount);
+		snowParticles->Weather.Enabled = WEATHER_VOLUME;
+		snowParticles->burst(snowCount);
+		snowParticles->SpawnRate = snowCount / 7.5f;
+		snowParticles->SortInterval = 4;
+		snowParticles->Collision.Field = &assetManager.getHeightField("scene");
+	}
 
-	snowParticles = new ParticleSystem(100);
+	renderQueue.Occlusion = &occlusionCuller;
+	renderQueue.DepthPrePass = DEPTH_PRE_PASS;
+	renderQueue.Transparency = TRANSPARENCY_MODE;
 
-	glBindVertexArray(0);
+	// Rejected ones go back to the render queue
+	std::vector<Entity> rejected;
+	world.forEach(Component::GPUCulled | Component::RenderMesh | Component::Material, [&](Archetype& archetype)
+	{
+		for (size_t i = 0; i < archetype.size(); i++)
+		{
+			archetype.GPUHandles[i] = gpuCuller.add(Drawable(archetype.Meshes[i], archetype.Materials[i]));
+			if (archetype.GPUHandles[i] == GPUCuller::InvalidHandle)
+				rejected.push_back(archetype.Entities[i]);
+		}
+	});
+	for (Entity entity : rejected)
+		world.removeComponents(entity, Component::GPUCulled);
+	gpuCuller.build();
+
+	GLState::getInstance().bindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 };
 
 void display(GLFWwindow* window, float time, float deltaTime)
 {
+	GLState::getInstance().beginFrame();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	ShaderManager::getInstance().updateShadersCommon(time, camera->Position);
+	ShaderManager::getInstance().poll();
+	ShaderManager::getInstance().updateShadersCommon(camera->Position);
 
 	// Camera stuff
 	glm::mat4 view = camera->getViewMatrix();
 	glm::mat4 projection = camera->getProjectionMatrix();
 	glm::mat4 viewProjection = projection * view;
 
-	// Skybox
-	glm::mat4 skyboxView = glm::mat4(glm::mat3(view));
-	glm::mat4 skyboxMVP = projection * skyboxView;
-	CubeMap skybox = AssetManager::getInstance().getCubeMap("MainCubeMap");
-	skybox.draw(skyboxMVP);
-
 	// Spot light
 	spotLight.Position = camera->Position;
 	spotLight.Direction = camera->Front;
 
+	world.integrate(deltaTime);
+	world.updateTransforms();
+
+	for (size_t i = 0; i < pointLights.size(); i++)
+		pointLights[i].Position = world.getWorldPosition(pointLightEntities[i]);
+
 	ShaderManager::getInstance().updateShadersLighting(directionalLight, pointLights, spotLight);
 
-	// Snow particles
-	snowParticles->update(deltaTime);
-	snowParticles->draw(viewProjection);
+	// Occluders
+	occlusionCuller.begin(viewProjection);
+	world.forEach(Component::Transform | Component::Occluder, [&](const Archetype& archetype)
+	{
+		for (size_t i = 0; i < archetype.size(); i++)
+			occlusionCuller.addOccluder(*archetype.Occluders[i], archetype.LocalToWorld[i]);
+	});
+	occlusionCuller.render();
+
+	// Particles simulate on the job system while the scene is culled and drawn
+	JobCounter particleJobs;
+	if (snowParticles != nullptr)
+	{
+		EntityRef sceneRef = world.get(sceneRoot);
+		snowParticles->Weather.Center = camera->Position;
+		snowParticles->Collision.FieldTransform = sceneRef.Table->LocalToWorld[sceneRef.Row];
+		snowParticles->beginUpdate(deltaTime, particleJobs);
+	}
+	if (gpuSnowParticles != nullptr)
+		gpuSnowParticles->update(deltaTime);
+
+	renderQueue.begin(viewProjection, camera->Position, camera->Front);
 
-	for (GameObject& gameObject : gameObjects)
+	for (Entity entity : world.getChangedEntities())
 	{
-		gameObject.update(deltaTime);
-		gameObject.updateModelMatrix();
-		gameObject.draw(viewProjection);
+		if ((world.getMask(entity) & Component::GPUCulled) == 0)
+			continue;
+		EntityRef ref = world.get(entity);
+		gpuCuller.setTransform(ref.Table->GPUHandles[ref.Row], ref.Table->LocalToWorld[ref.Row]);
 	}
+	renderQueue.submit(world);
+
+	MaterialLibrary::getInstance().sync();
+	MaterialTable::getInstance().bind();
+	gpuCuller.cull(viewProjection);
+	gpuCuller.draw(viewProjection);
+	renderQueue.prepare();
+	renderQueue.drawOpaque();
+	renderQueue.drawAlphaTested();
+
+	// Skybox, last among opaques so it only shades what nothing else covered
+	glm::mat4 skyboxView = glm::mat4(glm::mat3(view));
+	glm::mat4 skyboxMVP = projection * skyboxView;
+	const CubeMap& skybox = AssetManager::getInstance().getCubeMap("MainCubeMap");
+	skybox.draw(skyboxMVP);
+
+	// Particles fade against the opaque depth. Transparent surfaces write no depth, so particles
+	// go over them: flakes in front of glass stay clear, those behind it only miss its tint.
+	SceneDepth::getInstance().capture(view, projection);
+	renderQueue.drawTransparent();
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+	JobSystem::getInstance().wait(particleJobs);
+	if (snowParticles != nullptr)
+		snowParticles->draw(view, projection);
+	if (gpuSnowParticles != nullptr)
+		gpuSnowParticles->draw(view, projection);
+
+	gpuCuller.captureDepth(viewProjection);
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -122,8 +250,30 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	}
 }
 
+// Stops the camera at the bounds of the scene's submeshes. A blocked move still takes the axes
+// that are free, so the camera slides along walls instead of sticking to them.
+void moveCamera(const glm::vec3& offset)
+{
+	SegmentHit hit;
+	if (!world.intersectSegment(camera->Position, camera->Position + offset, hit))
+	{
+		camera->Position += offset;
+		return;
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glm::vec3 step = glm::vec3(0.0f);
+		step[axis] = offset[axis];
+		if (step[axis] != 0.0f && !world.intersectSegment(camera->Position, camera->Position + step, hit))
+			camera->Position += step;
+	}
+}
+
 void processKeyInput(GLFWwindow* window, float deltaTime)
 {
+	glm::vec3 previousPosition = camera->Position;
+
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 		camera->processKeyboard(CameraMovement::FORWARD, deltaTime);
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -132,6 +282,10 @@ void processKeyInput(GLFWwindow* window, float deltaTime)
 		camera->processKeyboard(CameraMovement::LEFT, deltaTime);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		camera->processKeyboard(CameraMovement::RIGHT, deltaTime);
+
+	glm::vec3 offset = camera->Position - previousPosition;
+	camera->Position = previousPosition;
+	moveCamera(offset);
 }
 
 void mouseCallback(GLFWwindow* window, double dPosX, double dPosY)
@@ -164,6 +318,13 @@ void scrollCallback(GLFWwindow* window, double xOffset, double yOffset)
 
 int main(void)
 {
+	// CPU only, prints timings and exits without opening a window
+	if (RUN_BENCHMARKS)
+	{
+		Benchmarks::run();
+		return 0;
+	}
+
 	if (!glfwInit()) { exit(EXIT_FAILURE); }
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -178,7 +339,7 @@ int main(void)
 	glfwSetScrollCallback(window, scrollCallback);
 	glfwSetKeyCallback(window, key_callback);
 
-	glEnable(GL_DEPTH_TEST);
+	GLState::getInstance().setDepthTest(true);
 	glClearColor(0.25f, 0.25f, 0.25f, 1.0f);
 
 	float lastFrameTime = (float)glfwGetTime();
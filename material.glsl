@@ -0,0 +1,65 @@
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
+
+struct MaterialParams
+{
+    vec4 diffuse; // w holds opacity
+    vec4 specular; // w holds shininess
+};
+
+layout (std430, binding = 2) readonly buffer MaterialParamBlock
+{
+    MaterialParams u_materialParams[];
+};
+
+#ifdef INDIRECT_DRAW
+// Comes with the draw instead of a uniform, see litShader.vert
+layout (location = 5) flat in int MaterialIndex;
+#define u_materialIndex MaterialIndex
+#else
+layout (location = 2) uniform int u_materialIndex;
+#endif
+
+#ifdef BATCHED_TEXTURES
+// Each texture reference is a bindless handle, or (array index, layer) when using texture arrays
+struct MaterialTextures
+{
+    uvec2 diffuse;
+    uvec2 normal;
+    uvec2 specular;
+};
+
+layout (std430, binding = 1) readonly buffer MaterialTable
+{
+    MaterialTextures u_materialTextures[];
+};
+
+#ifndef BINDLESS_TEXTURES
+// Units 4-15, see MaterialTable::FirstArrayUnit
+#define MAX_TEXTURE_ARRAYS 12
+layout (binding = 4) uniform sampler2DArray u_textureArrays[MAX_TEXTURE_ARRAYS];
+#endif
+
+vec4 sampleMaterialTexture(uvec2 ref, vec2 uv)
+{
+#ifdef BINDLESS_TEXTURES
+    return texture(sampler2D(ref), uv);
+#else
+    return texture(u_textureArrays[ref.x], vec3(uv, float(ref.y)));
+#endif
+}
+
+vec4 sampleDiffuseMap(vec2 uv)  { return sampleMaterialTexture(u_materialTextures[u_materialIndex].diffuse, uv); }
+vec4 sampleNormalMap(vec2 uv)   { return sampleMaterialTexture(u_materialTextures[u_materialIndex].normal, uv); }
+vec4 sampleSpecularMap(vec2 uv) { return sampleMaterialTexture(u_materialTextures[u_materialIndex].specular, uv); }
+#else
+// Units match TextureType, fixed here so no sampler uniforms are set at runtime
+layout (binding = 0) uniform sampler2D u_diffuseMap;
+layout (binding = 1) uniform sampler2D u_normalMap;
+layout (binding = 2) uniform sampler2D u_specularMap;
+
+vec4 sampleDiffuseMap(vec2 uv)  { return texture(u_diffuseMap, uv); }
+vec4 sampleNormalMap(vec2 uv)   { return texture(u_normalMap, uv); }
+vec4 sampleSpecularMap(vec2 uv) { return texture(u_specularMap, uv); }
+#endif
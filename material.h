@@ -2,14 +2,33 @@
 #include "texture.h"
 #include "shader.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
+using MaterialID = uint16_t;
+using TextureSetID = uint16_t;
+
+// Classified at import, see AssetManager. Passes are drawn in this order.
+enum class RenderPass
+{
+	Opaque = 0,
+	AlphaTested,
+	Transparent
+};
+
 class Material
 {
 public:
 	float Diffuse[3];
 	float Specular[3];
 	float Shininess;
+	float Opacity;
+	RenderPass Pass;
+	MaterialID ID;
+	TextureSetID TextureSet; // Shared by materials with the same three maps, see MaterialLibrary
+	bool Batched;
 
 	Material()
 	{
@@ -22,11 +41,18 @@ public:
 		Specular[2] = -1.0f;
 
 		Shininess = 32.0f;
+		Opacity = 1.0f;
+		Pass = RenderPass::Opaque;
+		ID = 0;
+		TextureSet = 0;
+		Batched = false;
 	}
 
 	Material(const std::vector<Texture>& textures, const Shader& shader)
-		: shader(shader)
+		: Material()
 	{
+		this->shader = shader;
+
 		for (const Texture& texture : textures)
 			setTexture(texture);
 	}
@@ -56,24 +82,83 @@ public:
 		return shader;
 	}
 
+	// Parameters live in the MaterialLibrary's parameter block, only the slot is per draw
 	void setMaterialUniforms() const
 	{
-		shader.setFloat("u_material.shininess", Shininess);
+		setMaterialUniforms(shader);
+	}
+
+	// For drawing with a stand-in program while the material's own one is still compiling
+	void setMaterialUniforms(const Shader& target) const
+	{
+		target.setInt(UniformLocation::MaterialIndex, ID);
+	}
+
+	const Texture& getTexture(TextureType type) const
+	{
+		if (type == TextureType::Normal)
+			return normalTexture;
+		else if (type == TextureType::Specular)
+			return specularTexture;
+		else
+			return diffuseTexture;
+	}
+
+	unsigned int getTextureID(TextureType type) const
+	{
+		return getTexture(type).ID;
+	}
 
-		if (Diffuse[0] != -1.0f)
-			shader.setVec3("u_material.diffuse", Diffuse);
-		if (Specular[0] != -1.0f)
-			shader.setVec3("u_material.specular", Specular);
+	bool sharesTextures(const Material& other) const
+	{
+		return diffuseTexture.ID == other.diffuseTexture.ID
+			&& normalTexture.ID == other.normalTexture.ID
+			&& specularTexture.ID == other.specularTexture.ID;
 	}
 
 	void bind() const
 	{
+		// Batched textures are resident or live in arrays bound by the MaterialTable
+		if (Batched)
+			return;
+
 		if (diffuseTexture.ID != 4096)
+			diffuseTexture.bindTexture((int)TextureType::Diffuse);
+		if (normalTexture.ID != 4096)
+			normalTexture.bindTexture((int)TextureType::Normal);
+		if (specularTexture.ID != 4096)
+			specularTexture.bindTexture((int)TextureType::Specular);
+	}
+
+	// Content equality, the IDs are not part of it
+	bool operator==(const Material& other) const
+	{
+		return shader.ID == other.shader.ID
+			&& sharesTextures(other)
+			&& std::equal(Diffuse, Diffuse + 3, other.Diffuse)
+			&& std::equal(Specular, Specular + 3, other.Specular)
+			&& Shininess == other.Shininess
+			&& Opacity == other.Opacity
+			&& Pass == other.Pass
+			&& Batched == other.Batched;
+	}
+
+	size_t hash() const
+	{
+		size_t seed = 0;
+		hashCombine(seed, shader.ID);
+		hashCombine(seed, diffuseTexture.ID);
+		hashCombine(seed, normalTexture.ID);
+		hashCombine(seed, specularTexture.ID);
+		for (int i = 0; i < 3; i++)
 		{
-			diffuseTexture.bindTexture(shader.ID, 0);
-			normalTexture.bindTexture(shader.ID, 1);
-			specularTexture.bindTexture(shader.ID, 2);
+			hashCombine(seed, Diffuse[i]);
+			hashCombine(seed, Specular[i]);
 		}
+		hashCombine(seed, Shininess);
+		hashCombine(seed, Opacity);
+		hashCombine(seed, (int)Pass);
+		return seed;
 	}
 
 private:
@@ -81,4 +166,10 @@ private:
 	Texture diffuseTexture;
 	Texture normalTexture;
 	Texture specularTexture;
+
+	template<typename T>
+	static void hashCombine(size_t& seed, const T& value)
+	{
+		seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
 };
\ No newline at end of file
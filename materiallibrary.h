@@ -0,0 +1,172 @@
+#pragma once
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "material.h"
+
+// Mirrors MaterialParams in the lit fragment shaders (std430, 32 byte stride)
+struct MaterialParams
+{
+	float Diffuse[4]; // w holds opacity
+	float Specular[4]; // w holds shininess
+};
+
+// Owns every material, deduplicated by content. Drawables refer to materials by MaterialID,
+// which doubles as the slot in the GPU parameter block. Slots are uploaded only when dirty.
+// The diffuse, normal and specular maps are interned as well, materials binding the same three
+// get the same TextureSetID.
+class MaterialLibrary
+{
+public:
+	static const int BindingPoint = 2;
+
+	static MaterialLibrary& getInstance()
+	{
+		static MaterialLibrary instance;
+		return instance;
+	}
+
+	MaterialID intern(const Material& material)
+	{
+		size_t hash = material.hash();
+		std::vector<MaterialID>& bucket = lookup[hash];
+
+		for (MaterialID id : bucket)
+		{
+			if (materials[id] == material)
+				return id;
+		}
+
+		MaterialID id = (MaterialID)materials.size();
+		materials.push_back(material);
+		materials.back().ID = id;
+		materials.back().TextureSet = internTextureSet(material);
+		bucket.push_back(id);
+		markDirty(id);
+		return id;
+	}
+
+	const Material& get(MaterialID id) const
+	{
+		return materials[id];
+	}
+
+	// Changes through here reach every drawable sharing the material. The material is reindexed
+	// under its new content, so later interns of the same content find it.
+	void set(MaterialID id, const Material& material)
+	{
+		unindex(id);
+		materials[id] = material;
+		materials[id].ID = id;
+		materials[id].TextureSet = internTextureSet(material);
+		lookup[materials[id].hash()].push_back(id);
+		markDirty(id);
+	}
+
+	size_t size() const
+	{
+		return materials.size();
+	}
+
+	void sync()
+	{
+		if (dirtyBegin < dirtyEnd)
+		{
+			if (capacity < materials.size())
+				reallocate();
+
+			std::vector<MaterialParams> params(dirtyEnd - dirtyBegin);
+			for (size_t i = dirtyBegin; i < dirtyEnd; i++)
+				params[i - dirtyBegin] = makeParams(materials[i]);
+
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyBegin * sizeof(MaterialParams), params.size() * sizeof(MaterialParams), &params[0]);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			dirtyBegin = materials.size();
+			dirtyEnd = 0;
+		}
+
+		if (ssbo != 0)
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoint, ssbo);
+	}
+
+private:
+	std::vector<Material> materials;
+	std::unordered_map<size_t, std::vector<MaterialID>> lookup;
+	std::map<std::tuple<unsigned int, unsigned int, unsigned int>, TextureSetID> textureSets;
+
+	unsigned int ssbo;
+	size_t capacity;
+	size_t dirtyBegin;
+	size_t dirtyEnd;
+
+	MaterialLibrary()
+	{
+		ssbo = 0;
+		capacity = 0;
+		dirtyBegin = 0;
+		dirtyEnd = 0;
+	}
+
+	void unindex(MaterialID id)
+	{
+		auto found = lookup.find(materials[id].hash());
+		std::vector<MaterialID>& bucket = found->second;
+		bucket.erase(std::find(bucket.begin(), bucket.end(), id));
+		if (bucket.empty())
+			lookup.erase(found);
+	}
+
+	TextureSetID internTextureSet(const Material& material)
+	{
+		auto maps = std::make_tuple(material.getTextureID(TextureType::Diffuse),
+			material.getTextureID(TextureType::Normal), material.getTextureID(TextureType::Specular));
+		return textureSets.insert(std::make_pair(maps, (TextureSetID)textureSets.size())).first->second;
+	}
+
+	void markDirty(MaterialID id)
+	{
+		dirtyBegin = std::min(dirtyBegin, (size_t)id);
+		dirtyEnd = std::max(dirtyEnd, (size_t)id + 1);
+	}
+
+	// Growing the buffer drops its contents, so every slot is rewritten
+	void reallocate()
+	{
+		capacity = std::max(materials.size(), capacity * 2);
+
+		if (ssbo == 0)
+			glGenBuffers(1, &ssbo);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(MaterialParams), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		dirtyBegin = 0;
+		dirtyEnd = materials.size();
+	}
+
+	static MaterialParams makeParams(const Material& material)
+	{
+		MaterialParams params;
+		for (int i = 0; i < 3; i++)
+		{
+			params.Diffuse[i] = material.Diffuse[i];
+			params.Specular[i] = material.Specular[i];
+		}
+		params.Diffuse[3] = material.Opacity;
+		params.Specular[3] = material.Shininess;
+		return params;
+	}
+
+public:
+	MaterialLibrary(MaterialLibrary const&) = delete;
+	void operator=(MaterialLibrary const&) = delete;
+};
@@ -0,0 +1,298 @@
+#pragma once
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "glstate.h"
+#include "materiallibrary.h"
+#include "shadermanager.h"
+
+enum class MaterialBatchMode
+{
+	Disabled = 0,
+	Bindless,
+	TextureArray
+};
+
+// Mirrors MaterialTextures in material.glsl (std430, 24 byte stride), indexed by MaterialID.
+// Each reference is either a bindless handle or an (array index, layer) pair.
+struct MaterialTableEntry
+{
+	GLuint64 Diffuse;
+	GLuint64 Normal;
+	GLuint64 Specular;
+};
+
+// Opt-in path that lets textured materials share one program without per-draw texture binds.
+// Enable it before the AssetManager loads; upload() then moves every textured material in the
+// MaterialLibrary onto the batched shader.
+class MaterialTable
+{
+public:
+	static const int BindingPoint = 1;
+	static const int FirstArrayUnit = 4;
+	static const int MaxTextureArrays = GLState::MaxTextureUnits - FirstArrayUnit;
+
+	static MaterialTable& getInstance()
+	{
+		static MaterialTable instance;
+		return instance;
+	}
+
+	MaterialBatchMode getMode() const
+	{
+		return mode;
+	}
+
+	void enable(MaterialBatchMode requestedMode)
+	{
+		mode = requestedMode;
+
+		if (mode == MaterialBatchMode::Bindless && !GLEW_ARB_bindless_texture)
+		{
+			std::cout << "ARB_bindless_texture unavailable, falling back to texture arrays\n";
+			mode = MaterialBatchMode::TextureArray;
+		}
+
+		batchedKeywords = ShaderKeyword::BatchedTextures;
+		if (mode == MaterialBatchMode::Bindless)
+			batchedKeywords |= ShaderKeyword::BindlessTextures;
+	}
+
+	void upload()
+	{
+		if (mode == MaterialBatchMode::Disabled)
+			return;
+
+		MaterialLibrary& library = MaterialLibrary::getInstance();
+		ShaderManager& shaderManager = ShaderManager::getInstance();
+		entries.assign(library.size(), MaterialTableEntry());
+
+		unsigned int batchedCount = 0;
+		for (MaterialID id = 0; id < library.size(); id++)
+		{
+			if (registerMaterial(library.get(id), entries[id]))
+			{
+				Material material = library.get(id);
+				Shader variant = shaderManager.getVariant(material.getShader().Keywords | batchedKeywords);
+				material.Batched = true;
+				material.setShader(variant);
+				library.set(id, material);
+				batchedCount++;
+			}
+		}
+
+		if (batchedCount == 0)
+			return;
+
+		if (mode == MaterialBatchMode::Bindless)
+			resolveBindlessHandles();
+		else
+			buildTextureArrays();
+
+		glGenBuffers(1, &ssbo);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, entries.size() * sizeof(MaterialTableEntry), &entries[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		std::cout << "Material table: " << batchedCount << " materials";
+		if (mode == MaterialBatchMode::TextureArray)
+			std::cout << " in " << arrays.size() << " texture arrays";
+		std::cout << std::endl;
+	}
+
+	void bind() const
+	{
+		if (ssbo == 0)
+			return;
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoint, ssbo);
+
+		GLState& glState = GLState::getInstance();
+		for (size_t i = 0; i < arrays.size(); i++)
+			glState.bindTexture(FirstArrayUnit + (unsigned int)i, GL_TEXTURE_2D_ARRAY, arrays[i].ID);
+	}
+
+private:
+	struct TextureArray
+	{
+		unsigned int ID;
+		int Width;
+		int Height;
+		int Format;
+		std::vector<unsigned int> Layers;
+	};
+
+	MaterialBatchMode mode;
+	unsigned int batchedKeywords;
+	std::vector<MaterialTableEntry> entries;
+	std::vector<TextureArray> arrays;
+	unsigned int ssbo;
+
+	MaterialTable()
+	{
+		mode = MaterialBatchMode::Disabled;
+		batchedKeywords = 0;
+		ssbo = 0;
+	}
+
+	// Returns false if the material has to stay on the classic per-draw binding path
+	bool registerMaterial(const Material& material, MaterialTableEntry& entry)
+	{
+		if (material.getTextureID(TextureType::Diffuse) == 4096)
+			return false;
+
+		const Texture* textures[3] =
+		{
+			&material.getTexture(TextureType::Diffuse),
+			&material.getTexture(TextureType::Normal),
+			&material.getTexture(TextureType::Specular)
+		};
+		GLuint64* refs[3] = { &entry.Diffuse, &entry.Normal, &entry.Specular };
+
+		// Arrays and layers are only ever appended, so their sizes are enough to undo this material
+		std::vector<size_t> layerCounts;
+		for (const TextureArray& array : arrays)
+			layerCounts.push_back(array.Layers.size());
+
+		for (int i = 0; i < 3; i++)
+		{
+			// Maps the material's variant does not sample are left out of the table
+			if (textures[i]->ID == 4096)
+				continue;
+
+			if (mode == MaterialBatchMode::Bindless)
+				*refs[i] = textures[i]->ID;
+			else if (!allocateLayer(*textures[i], *refs[i]))
+			{
+				rollback(layerCounts);
+				entry = MaterialTableEntry();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Drops the arrays and layers added since layerCounts was taken
+	void rollback(const std::vector<size_t>& layerCounts)
+	{
+		arrays.resize(layerCounts.size());
+		for (size_t i = 0; i < arrays.size(); i++)
+			arrays[i].Layers.resize(layerCounts[i]);
+	}
+
+	bool allocateLayer(const Texture& texture, GLuint64& ref)
+	{
+		auto sameShape = [&](const TextureArray& array)
+		{
+			return array.Width == texture.Width && array.Height == texture.Height && array.Format == texture.Format;
+		};
+
+		auto itr = std::find_if(arrays.begin(), arrays.end(), sameShape);
+		if (itr == arrays.end())
+		{
+			if (arrays.size() == MaxTextureArrays)
+				return false;
+
+			arrays.push_back({ 0, texture.Width, texture.Height, texture.Format, {} });
+			itr = arrays.end() - 1;
+		}
+
+		std::vector<unsigned int>& layers = itr->Layers;
+		auto layer = std::find(layers.begin(), layers.end(), texture.ID);
+		if (layer == layers.end())
+		{
+			layers.push_back(texture.ID);
+			layer = layers.end() - 1;
+		}
+
+		GLuint64 arrayIndex = (GLuint64)(itr - arrays.begin());
+		GLuint64 layerIndex = (GLuint64)(layer - layers.begin());
+		ref = arrayIndex | (layerIndex << 32);
+		return true;
+	}
+
+	void resolveBindlessHandles()
+	{
+		std::unordered_map<GLuint64, GLuint64> handles;
+
+		MaterialLibrary& library = MaterialLibrary::getInstance();
+
+		for (MaterialID id = 0; id < entries.size(); id++)
+		{
+			if (!library.get(id).Batched)
+				continue;
+
+			MaterialTableEntry& entry = entries[id];
+			for (GLuint64* ref : { &entry.Diffuse, &entry.Normal, &entry.Specular })
+			{
+				if (*ref == 0)
+					continue;
+
+				auto itr = handles.find(*ref);
+				if (itr == handles.end())
+				{
+					GLuint64 handle = glGetTextureHandleARB((GLuint)*ref);
+					glMakeTextureHandleResidentARB(handle);
+					itr = handles.insert(std::make_pair(*ref, handle)).first;
+				}
+				*ref = itr->second;
+			}
+		}
+	}
+
+	// Layers are filled with glCopyImageSubData straight from the already uploaded 2D textures,
+	// including their mip chains, so nothing is decoded from disk twice.
+	void buildTextureArrays()
+	{
+		GLState& glState = GLState::getInstance();
+
+		for (TextureArray& array : arrays)
+		{
+			int levels = (int)std::floor(std::log2((float)std::max(array.Width, array.Height))) + 1;
+
+			glGenTextures(1, &array.ID);
+			glState.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.ID);
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, sizedFormat(array.Format), array.Width, array.Height, (GLsizei)array.Layers.size());
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			for (size_t layer = 0; layer < array.Layers.size(); layer++)
+			{
+				for (int level = 0; level < levels; level++)
+				{
+					int width = std::max(1, array.Width >> level);
+					int height = std::max(1, array.Height >> level);
+					glCopyImageSubData(
+						array.Layers[layer], GL_TEXTURE_2D, level, 0, 0, 0,
+						array.ID, GL_TEXTURE_2D_ARRAY, level, 0, 0, (GLint)layer,
+						width, height, 1
+					);
+				}
+			}
+		}
+	}
+
+	static GLenum sizedFormat(int format)
+	{
+		if (format == GL_RED)
+			return GL_R8;
+		else if (format == GL_RG)
+			return GL_RG8;
+		else if (format == GL_RGB)
+			return GL_RGB8;
+		else
+			return GL_RGBA8;
+	}
+
+public:
+	MaterialTable(MaterialTable const&) = delete;
+	void operator=(MaterialTable const&) = delete;
+};
@@ -0,0 +1,156 @@
+#pragma once
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "glstate.h"
+#include "vertexarrayobject.h"
+
+// Mirrors MeshRange in gpuCulling.comp (std430, 16 byte stride)
+struct GPUMeshRange
+{
+	uint32_t IndexCount;
+	uint32_t FirstIndex;
+	int32_t BaseVertex;
+	uint32_t Padding;
+};
+
+// Every mesh in one set of vertex and index buffers, so a single VAO serves a whole multi-draw.
+// Meshes are copied over from their own VertexArrayObject buffers on the GPU, no CPU copy needed.
+// Streams a mesh lacks (texture coordinates, tangents) are left zeroed.
+class MeshPool
+{
+public:
+	static const int DrawIndexLocation = 4;
+
+	unsigned int VAO;
+	std::vector<GPUMeshRange> Meshes;
+
+	MeshPool()
+	{
+		VAO = 0;
+		positionBuffer = normalBuffer = texCoordBuffer = tangentBuffer = indexBuffer = drawIndexBuffer = 0;
+	}
+
+	// Returns the mesh index, valid once build() has run
+	uint32_t add(const VertexArrayObject& vao)
+	{
+		for (uint32_t i = 0; i < sources.size(); i++)
+		{
+			if (sources[i].ID == vao.ID)
+				return i;
+		}
+
+		sources.push_back(vao);
+		return (uint32_t)sources.size() - 1;
+	}
+
+	// drawCapacity sizes the per-instance draw index stream that GPUCuller's baseInstance indexes
+	void build(uint32_t drawCapacity)
+	{
+		std::vector<uint32_t> vertexCounts;
+		uint32_t vertexTotal = 0;
+		uint32_t indexTotal = 0;
+
+		for (const VertexArrayObject& source : sources)
+		{
+			uint32_t vertexCount = (uint32_t)(getBufferSize(source.VertexPositionID) / (3 * sizeof(float)));
+			Meshes.push_back({ (uint32_t)source.IndicesSize, indexTotal, (int32_t)vertexTotal, 0 });
+			vertexCounts.push_back(vertexCount);
+			vertexTotal += vertexCount;
+			indexTotal += (uint32_t)source.IndicesSize;
+		}
+
+		glGenVertexArrays(1, &VAO);
+		GLState::getInstance().bindVertexArray(VAO);
+
+		positionBuffer = createStream(0, 3, vertexTotal);
+		normalBuffer = createStream(1, 3, vertexTotal);
+		texCoordBuffer = createStream(2, 2, vertexTotal);
+		tangentBuffer = createStream(3, 3, vertexTotal);
+
+		glGenBuffers(1, &indexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, std::max(indexTotal, 1u) * sizeof(uint32_t), NULL, GL_STATIC_DRAW);
+
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			const VertexArrayObject& source = sources[i];
+			GLintptr vertexOffset = Meshes[i].BaseVertex;
+
+			copyStream(source.VertexPositionID, positionBuffer, vertexOffset, vertexCounts[i], 3);
+			copyStream(source.VertexNormalsID, normalBuffer, vertexOffset, vertexCounts[i], 3);
+			copyStream(source.VertexTexCoordsID, texCoordBuffer, vertexOffset, vertexCounts[i], 2);
+			copyStream(source.VertexTangentsID, tangentBuffer, vertexOffset, vertexCounts[i], 3);
+
+			glBindBuffer(GL_COPY_READ_BUFFER, source.IndicesID);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+				Meshes[i].FirstIndex * sizeof(uint32_t), source.IndicesSize * sizeof(uint32_t));
+		}
+
+		std::vector<uint32_t> drawIndices(std::max(drawCapacity, 1u));
+		for (uint32_t i = 0; i < drawIndices.size(); i++)
+			drawIndices[i] = i;
+
+		glGenBuffers(1, &drawIndexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(uint32_t), drawIndices.data(), GL_STATIC_DRAW);
+		glVertexAttribIPointer(DrawIndexLocation, 1, GL_UNSIGNED_INT, 0, 0);
+		glVertexAttribDivisor(DrawIndexLocation, 1);
+		glEnableVertexAttribArray(DrawIndexLocation);
+
+		sources.clear();
+	}
+
+	void bind() const
+	{
+		GLState::getInstance().bindVertexArray(VAO);
+	}
+
+private:
+	unsigned int positionBuffer;
+	unsigned int normalBuffer;
+	unsigned int texCoordBuffer;
+	unsigned int tangentBuffer;
+	unsigned int indexBuffer;
+	unsigned int drawIndexBuffer;
+	std::vector<VertexArrayObject> sources;
+
+	static GLint64 getBufferSize(unsigned int buffer)
+	{
+		if (buffer == 4096)
+			return 0;
+
+		GLint64 size = 0;
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+		return size;
+	}
+
+	static unsigned int createStream(int location, int size, uint32_t vertexCount)
+	{
+		unsigned int buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, std::max(vertexCount, 1u) * size * sizeof(float), NULL, GL_STATIC_DRAW);
+		glClearBufferData(GL_ARRAY_BUFFER, GL_R32F, GL_RED, GL_FLOAT, NULL);
+		glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(location);
+		return buffer;
+	}
+
+	// Copies at most the stream's share of the destination, some sources pack more components
+	static void copyStream(unsigned int source, unsigned int destination, GLintptr vertexOffset, uint32_t vertexCount, int size)
+	{
+		GLint64 length = std::min(getBufferSize(source), (GLint64)vertexCount * size * (GLint64)sizeof(float));
+		if (length <= 0)
+			return;
+
+		glBindBuffer(GL_COPY_READ_BUFFER, source);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, vertexOffset * size * sizeof(float), (GLsizeiptr)length);
+	}
+};
@@ -0,0 +1,311 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+#include "jobsystem.h"
+
+// Triangles kept on the CPU for occlusion, positions in the space of the owning object
+struct OccluderMesh
+{
+	std::vector<glm::vec3> Vertices;
+	std::vector<uint32_t> Indices;
+};
+
+struct OcclusionCullStats
+{
+	unsigned int Triangles;
+	unsigned int Rasterized;
+};
+
+// Software depth buffer for occlusion culling, no GL involved.
+// Occluders are transformed once, binned into screen rectangles and each bin is rasterized as a
+// job on the JobSystem, four pixels per SSE step. Every 8x8 tile then keeps the farthest depth it holds,
+// and bounds are occluded when their nearest point is behind that depth in every tile they cover.
+// This is the coarse half of masked occlusion culling: one conservative depth per tile instead of
+// two layers with coverage masks, which keeps the test cheap and the buffer simple.
+// Depth is NDC z mapped to [0, 1], so it works for perspective and orthographic cameras.
+class OcclusionCuller
+{
+public:
+	static const int Width = 256;
+	static const int Height = 144;
+	static const int TileSize = 8;
+	static const int TilesX = Width / TileSize;
+	static const int TilesY = Height / TileSize;
+	static const int BinsX = 4;
+	static const int BinsY = 3;
+	static const int BinWidth = Width / BinsX;
+	static const int BinHeight = Height / BinsY;
+
+	// Absorbs interpolation error so occluders never hide themselves
+	float DepthBias;
+	OcclusionCullStats Stats;
+
+	OcclusionCuller()
+	{
+		DepthBias = 1e-5f;
+		Stats = OcclusionCullStats();
+		viewProjection = glm::mat4(1.0f);
+		depth.assign(Width * Height, 1.0f);
+		tileMaxDepth.assign(TilesX * TilesY, 1.0f);
+		bins.resize(BinsX * BinsY);
+	}
+
+	void begin(const glm::mat4& viewProjection)
+	{
+		this->viewProjection = viewProjection;
+		triangles.clear();
+		for (std::vector<uint32_t>& bin : bins)
+			bin.clear();
+		Stats = OcclusionCullStats();
+	}
+
+	// Triangles crossing the near plane are dropped, which only ever makes the occluder smaller
+	void addOccluder(const OccluderMesh& mesh, const glm::mat4& model)
+	{
+		glm::mat4 localToClip = viewProjection * model;
+
+		projected.resize(mesh.Vertices.size());
+		for (size_t i = 0; i < mesh.Vertices.size(); i++)
+		{
+			glm::vec4 clip = localToClip * glm::vec4(mesh.Vertices[i], 1.0f);
+			projected[i] = clip.w > NearW ? toScreen(clip) : glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+		}
+
+		for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+		{
+			Stats.Triangles++;
+			const glm::vec4& a = projected[mesh.Indices[i]];
+			const glm::vec4& b = projected[mesh.Indices[i + 1]];
+			const glm::vec4& c = projected[mesh.Indices[i + 2]];
+			if (a.w < 0.0f || b.w < 0.0f || c.w < 0.0f)
+				continue;
+
+			addTriangle(a, b, c);
+		}
+	}
+
+	void render()
+	{
+		JobSystem& jobs = JobSystem::getInstance();
+		JobCounter counter;
+		jobs.dispatch(BinsX * BinsY, [this](uint32_t bin) { rasterizeBin((int)bin); }, counter);
+		jobs.wait(counter);
+
+		Stats.Rasterized = (unsigned int)triangles.size();
+	}
+
+	// min and max are an AABB in the space localToClip maps from
+	bool isOccluded(const glm::vec3& min, const glm::vec3& max, const glm::mat4& localToClip) const
+	{
+		glm::vec2 screenMin = glm::vec2(FLT_MAX);
+		glm::vec2 screenMax = glm::vec2(-FLT_MAX);
+		float nearest = FLT_MAX;
+
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 p = glm::vec3(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z);
+			glm::vec4 clip = localToClip * glm::vec4(p, 1.0f);
+			if (clip.w <= NearW)
+				return false;
+
+			glm::vec4 screen = toScreen(clip);
+			screenMin = glm::min(screenMin, glm::vec2(screen));
+			screenMax = glm::max(screenMax, glm::vec2(screen));
+			nearest = std::min(nearest, screen.z);
+		}
+
+		int tileX0 = std::max(0, (int)std::floor(screenMin.x) / TileSize);
+		int tileY0 = std::max(0, (int)std::floor(screenMin.y) / TileSize);
+		int tileX1 = std::min(TilesX - 1, (int)std::floor(screenMax.x) / TileSize);
+		int tileY1 = std::min(TilesY - 1, (int)std::floor(screenMax.y) / TileSize);
+		if (screenMax.x < 0.0f || screenMax.y < 0.0f || tileX0 > tileX1 || tileY0 > tileY1)
+			return false;
+
+		float testDepth = nearest - DepthBias;
+		for (int y = tileY0; y <= tileY1; y++)
+		{
+			for (int x = tileX0; x <= tileX1; x++)
+			{
+				if (tileMaxDepth[y * TilesX + x] >= testDepth)
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	const std::vector<float>& getDepthBuffer() const
+	{
+		return depth;
+	}
+
+private:
+	static constexpr float NearW = 1e-4f;
+
+	// Screen space vertices and the depth plane, z = DepthA * x + DepthB * y + DepthC
+	struct ScreenTriangle
+	{
+		glm::vec2 A, B, C;
+		float DepthA, DepthB, DepthC;
+		int MinX, MinY, MaxX, MaxY;
+	};
+
+	glm::mat4 viewProjection;
+	std::vector<glm::vec4> projected;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<uint32_t>> bins;
+	std::vector<float> depth;
+	std::vector<float> tileMaxDepth;
+
+	static glm::vec4 toScreen(const glm::vec4& clip)
+	{
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		return glm::vec4((ndc.x * 0.5f + 0.5f) * Width, (ndc.y * 0.5f + 0.5f) * Height, ndc.z * 0.5f + 0.5f, 1.0f);
+	}
+
+	void addTriangle(glm::vec4 a, glm::vec4 b, glm::vec4 c)
+	{
+		float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (std::abs(area) < 1e-8f)
+			return;
+
+		// Both windings are occluders, normalize to counter-clockwise
+		if (area < 0.0f)
+		{
+			std::swap(b, c);
+			area = -area;
+		}
+
+		ScreenTriangle triangle;
+		triangle.A = glm::vec2(a);
+		triangle.B = glm::vec2(b);
+		triangle.C = glm::vec2(c);
+		triangle.MinX = std::max(0, (int)std::floor(std::min(a.x, std::min(b.x, c.x))));
+		triangle.MinY = std::max(0, (int)std::floor(std::min(a.y, std::min(b.y, c.y))));
+		triangle.MaxX = std::min(Width - 1, (int)std::ceil(std::max(a.x, std::max(b.x, c.x))));
+		triangle.MaxY = std::min(Height - 1, (int)std::ceil(std::max(a.y, std::max(b.y, c.y))));
+		if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+			return;
+
+		float depthX = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+		float depthY = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+		triangle.DepthA = depthX;
+		triangle.DepthB = depthY;
+		triangle.DepthC = a.z - depthX * a.x - depthY * a.y;
+
+		uint32_t index = (uint32_t)triangles.size();
+		triangles.push_back(triangle);
+
+		for (int binY = triangle.MinY / BinHeight; binY <= triangle.MaxY / BinHeight; binY++)
+		{
+			for (int binX = triangle.MinX / BinWidth; binX <= triangle.MaxX / BinWidth; binX++)
+				bins[binY * BinsX + binX].push_back(index);
+		}
+	}
+
+	void rasterizeBin(int bin)
+	{
+		int binX0 = (bin % BinsX) * BinWidth;
+		int binY0 = (bin / BinsX) * BinHeight;
+		int binX1 = binX0 + BinWidth - 1;
+		int binY1 = binY0 + BinHeight - 1;
+
+		for (int y = binY0; y <= binY1; y++)
+			std::fill(depth.begin() + y * Width + binX0, depth.begin() + y * Width + binX1 + 1, 1.0f);
+
+		for (uint32_t index : bins[bin])
+			rasterizeTriangle(triangles[index], binX0, binY0, binX1, binY1);
+
+		for (int tileY = binY0 / TileSize; tileY <= binY1 / TileSize; tileY++)
+		{
+			for (int tileX = binX0 / TileSize; tileX <= binX1 / TileSize; tileX++)
+			{
+				float maxDepth = 0.0f;
+				for (int y = tileY * TileSize; y < (tileY + 1) * TileSize; y++)
+				{
+					const float* row = &depth[y * Width + tileX * TileSize];
+					for (int x = 0; x < TileSize; x++)
+						maxDepth = std::max(maxDepth, row[x]);
+				}
+				tileMaxDepth[tileY * TilesX + tileX] = maxDepth;
+			}
+		}
+	}
+
+	// Edge functions are positive inside a counter-clockwise triangle, sampled at pixel centers
+	void rasterizeTriangle(const ScreenTriangle& triangle, int binX0, int binY0, int binX1, int binY1)
+	{
+		int minX = std::max(triangle.MinX, binX0) & ~3;
+		int minY = std::max(triangle.MinY, binY0);
+		int maxX = std::min(triangle.MaxX, binX1);
+		int maxY = std::min(triangle.MaxY, binY1);
+
+		const glm::vec2 vertices[3] = { triangle.A, triangle.B, triangle.C };
+		float edgeA[3], edgeB[3], edgeC[3];
+		for (int e = 0; e < 3; e++)
+		{
+			const glm::vec2& from = vertices[e];
+			const glm::vec2& to = vertices[(e + 1) % 3];
+			edgeA[e] = from.y - to.y;
+			edgeB[e] = to.x - from.x;
+			edgeC[e] = from.x * to.y - from.y * to.x;
+		}
+
+#ifdef FRUSTUM_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		__m128 stepA[3], rowBase[3];
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			float centerY = y + 0.5f;
+			for (int e = 0; e < 3; e++)
+			{
+				stepA[e] = _mm_set1_ps(edgeA[e]);
+				rowBase[e] = _mm_set1_ps(edgeB[e] * centerY + edgeC[e]);
+			}
+			__m128 depthA = _mm_set1_ps(triangle.DepthA);
+			__m128 depthRow = _mm_set1_ps(triangle.DepthB * centerY + triangle.DepthC);
+
+			float* row = &depth[y * Width];
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				__m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepA[0], centerX), rowBase[0]), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepA[1], centerX), rowBase[1]), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepA[2], centerX), rowBase[2]), zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				__m128 z = _mm_add_ps(_mm_mul_ps(depthA, centerX), depthRow);
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_min_ps(old, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+			}
+		}
+#else
+		for (int y = minY; y <= maxY; y++)
+		{
+			float centerY = y + 0.5f;
+			float* row = &depth[y * Width];
+			for (int x = minX; x <= maxX; x++)
+			{
+				float centerX = x + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3; e++)
+					inside &= edgeA[e] * centerX + edgeB[e] * centerY + edgeC[e] >= 0.0f;
+
+				if (inside)
+					row[x] = std::min(row[x], triangle.DepthA * centerX + triangle.DepthB * centerY + triangle.DepthC);
+			}
+		}
+#endif
+	}
+};
@@ -0,0 +1,19 @@
+#version 430
+layout (binding = 0) uniform sampler2D u_accumulation;
+layout (binding = 1) uniform sampler2D u_revealage;
+
+layout (location = 0) out vec4 fragColor;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(u_revealage, texel, 0).r;
+
+    // Nothing transparent covered this pixel
+    if (revealage == 1.0)
+        discard;
+
+    // Blended with (1 - src alpha, src alpha), so the opaque color is kept by the revealage
+    vec4 accumulation = texelFetch(u_accumulation, texel, 0);
+    fragColor = vec4(accumulation.rgb / max(accumulation.a, 1e-5), revealage);
+}
@@ -0,0 +1,31 @@
+#version 430
+layout (location = 0) in vec2 TexCoords;
+layout (location = 1) in float ViewDepth;
+
+layout (location = 0) out vec4 fragColor;
+
+layout (binding = 0) uniform sampler2D u_texture;
+layout (binding = 1) uniform sampler2D u_sceneDepth;
+
+layout (location = 2) uniform mat4 u_inverseProjection;
+layout (location = 3) uniform float u_softDistance;
+
+// View space distance to the opaque surface behind this fragment, see SceneDepth
+float sceneViewDepth()
+{
+    float depth = texelFetch(u_sceneDepth, ivec2(gl_FragCoord.xy), 0).r;
+    vec4 viewPosition = u_inverseProjection * vec4(0.0, 0.0, depth * 2.0 - 1.0, 1.0);
+    return -viewPosition.z / viewPosition.w;
+}
+
+void main()
+{
+    // Round flakes out of the square quad
+    float edge = 1.0 - smoothstep(0.3, 0.5, length(TexCoords - 0.5));
+
+    // Soft particles fade out as they near the scene instead of cutting into it
+    float fade = clamp((sceneViewDepth() - ViewDepth) / u_softDistance, 0.0, 1.0);
+
+    vec4 color = texture(u_texture, TexCoords);
+    fragColor = vec4(color.rgb, color.a * edge * fade);
+}
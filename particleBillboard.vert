@@ -0,0 +1,47 @@
+#version 430
+layout (location = 0) in vec3 v_position;
+
+layout (location = 0) out vec2 TexCoords;
+layout (location = 1) out float ViewDepth;
+
+#ifdef GPU_PARTICLES
+#include "gpuparticles.glsl"
+
+// This frame's survivors, instance i draws entry i, see GPUParticleSystem
+layout (std430, binding = 10) readonly buffer DrawListBlock
+{
+    uint u_drawList[];
+};
+#else
+// Per instance, see ParticleStore::writeInstances
+layout (location = 4) in vec3 v_instancePosition;
+layout (location = 5) in uint v_instanceSizeRoll;
+#endif
+
+layout (location = 0) uniform mat4 u_view;
+layout (location = 1) uniform mat4 u_projection;
+
+void main()
+{
+#ifdef GPU_PARTICLES
+    Particle particle = u_particles[u_drawList[gl_InstanceID]];
+    vec3 position = particle.positionSize.xyz;
+    float size = particle.positionSize.w;
+    float roll = particle.roll;
+#else
+    vec3 position = v_instancePosition;
+    vec2 sizeRoll = unpackHalf2x16(v_instanceSizeRoll);
+    float size = sizeRoll.x;
+    float roll = sizeRoll.y;
+#endif
+
+    // The quad is spread in view space, so it always faces the camera
+    float s = sin(roll);
+    float c = cos(roll);
+    vec2 corner = mat2(c, s, -s, c) * v_position.xy * size;
+    vec4 viewPosition = u_view * vec4(position, 1.0) + vec4(corner, 0.0, 0.0);
+
+    gl_Position = u_projection * viewPosition;
+    TexCoords = v_position.xy + 0.5;
+    ViewDepth = -viewPosition.z;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+
+#include "assetmanager.h"
+#include "glstate.h"
+#include "scenedepth.h"
+#include "shader.h"
+
+// Camera-facing particle quads, spread and rolled in particleBillboard.vert so the CPU builds no
+// matrices. Flakes sample snow.png, blend over the scene unsorted and fade out within
+// SoftDistance of the depth in SceneDepth, so draw them after the opaque passes and the capture.
+class ParticleBillboard
+{
+public:
+	float SoftDistance;
+
+	// defines picks the instance source, empty for ParticleStore instances
+	ParticleBillboard(const std::string& defines = "")
+	{
+		SoftDistance = 0.5f;
+		shader = Shader("particleBillboard.vert", "particleBillboard.frag", defines);
+		texture = AssetManager::getInstance().getTexture("snow.png").ID;
+	}
+
+	// Binds the program and blend state for the draws that follow, until end()
+	void begin(const glm::mat4& view, const glm::mat4& projection) const
+	{
+		GLState& glState = GLState::getInstance();
+		shader.use();
+		shader.setMat4(UniformLocation::View, view);
+		shader.setMat4(UniformLocation::Projection, projection);
+		shader.setMat4(UniformLocation::InverseProjection, glm::inverse(projection));
+		shader.setFloat(UniformLocation::SoftDistance, SoftDistance);
+
+		glState.bindTexture(0, GL_TEXTURE_2D, texture);
+		glState.bindTexture(1, GL_TEXTURE_2D, SceneDepth::getInstance().getTexture());
+		glState.setDepthMask(false);
+		glState.setBlend(true);
+		glState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
+
+	void end() const
+	{
+		GLState& glState = GLState::getInstance();
+		glState.setBlend(false);
+		glState.setDepthMask(true);
+	}
+
+private:
+	Shader shader;
+	unsigned int texture;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+
+// Live particle allowance shared by every ParticleSystem. Each system owns a fixed pool, the
+// budget caps how much of those pools may be alive at once, so many emitters can coexist with
+// a bounded total and no allocation per frame. Used from the GL thread only.
+class ParticleBudget
+{
+public:
+	static ParticleBudget& getInstance()
+	{
+		static ParticleBudget instance;
+		return instance;
+	}
+
+	void setCapacity(size_t capacity)
+	{
+		this->capacity = capacity;
+	}
+
+	size_t getCapacity() const
+	{
+		return capacity;
+	}
+
+	size_t getUsed() const
+	{
+		return used;
+	}
+
+	// Grants up to count, less once the budget runs out
+	size_t acquire(size_t count)
+	{
+		size_t granted = std::min(count, capacity - std::min(used, capacity));
+		used += granted;
+		return granted;
+	}
+
+	void release(size_t count)
+	{
+		used -= std::min(count, used);
+	}
+
+private:
+	size_t capacity;
+	size_t used;
+
+	ParticleBudget()
+	{
+		capacity = 1 << 20;
+		used = 0;
+	}
+
+public:
+	ParticleBudget(ParticleBudget const&) = delete;
+	void operator=(ParticleBudget const&) = delete;
+};
@@ -0,0 +1,552 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+#include "heightfield.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PARTICLE_AVX2
+#define PARTICLE_SSE
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PARTICLE_SSE
+#endif
+
+// Mirrors the instance attributes of particleBillboard.vert, the quad is built on the GPU
+struct ParticleInstance
+{
+	glm::vec3 Position;
+	uint32_t SizeRoll; // Half floats, size in the low bits as in packHalf2x16
+};
+
+// Thins particles out with distance from a viewer: all are kept within Near, a FarDensity
+// fraction of them at Far and beyond. Which slots survive is fixed, so nothing flickers.
+struct DensityFalloff
+{
+	float Near;
+	float Far;
+	float FarDensity;
+};
+
+// What a particle does on reaching a surface. Stuck particles stay put until they expire and
+// sliding ones move along it, dying ones expire right away. Sliding particles keep their fall
+// speed and are put back on the surface every update, so they fall again once it ends.
+enum class CollisionResponse
+{
+	None,
+	Stick,
+	Slide,
+	Die
+};
+
+// Particles collide where they are below the height field's surface by less than Thickness.
+// Deeper ones were already under it, e.g. spawned beneath a roof, and pass through. Thickness
+// should cover the farthest a particle moves in one update. The field is baked in the space of
+// the object it came from; FieldTransform places that object in the world, so the field follows
+// it when it moves. Heights and Thickness are along the object's up axis.
+struct ParticleCollision
+{
+	const HeightField* Field;
+	CollisionResponse Response;
+	float Thickness;
+	glm::mat4 FieldTransform;
+};
+
+// Structure of arrays particle slots, 44 bytes each and nothing else. Liveness and rendering
+// state belong to the owning system. Arrays are padded to whole SIMD lanes so the kernels have
+// no scalar tail. Dead slots, padding included, are simulated like the rest but have no size
+// and never expire, so they neither draw nor reach an expiry callback.
+// Disjoint ranges may be updated and written out from different threads at the same time.
+class ParticleStore
+{
+public:
+	static const size_t Lanes = 8;
+
+	std::vector<float> PositionX, PositionY, PositionZ;
+	std::vector<float> VelocityX, VelocityY, VelocityZ;
+	std::vector<float> Roll;
+	std::vector<float> RollSpeed; // Radians per second
+	std::vector<float> Size;
+	std::vector<float> Age;
+	std::vector<float> Lifetime;
+
+	ParticleStore()
+	{
+		count = 0;
+	}
+
+	// Every slot starts dead
+	void resize(size_t count)
+	{
+		this->count = count;
+		size_t padded = getPaddedSize();
+		for (std::vector<float>* stream : streams())
+			stream->assign(padded, 0.0f);
+
+		for (size_t i = 0; i < padded; i++)
+			kill(i);
+	}
+
+	// Parks slot i where it stays until reinitialized, roll is kept
+	void kill(size_t i)
+	{
+		VelocityX[i] = VelocityY[i] = VelocityZ[i] = 0.0f;
+		RollSpeed[i] = 0.0f;
+		Size[i] = 0.0f;
+		Age[i] = 0.0f;
+		Lifetime[i] = FLT_MAX;
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	size_t getPaddedSize() const
+	{
+		return (count + Lanes - 1) & ~(Lanes - 1);
+	}
+
+	// Integrates [first, last) and calls expire(index) for each particle whose age reached its
+	// lifetime, right after its lanes are written back. expire is expected to kill the slot or
+	// reset its Age. first and last must be multiples of Lanes.
+	template<typename Expire>
+	void update(size_t first, size_t last, float deltaTime, Expire expire)
+	{
+#if defined(PARTICLE_AVX2)
+		const __m256 dt = _mm256_set1_ps(deltaTime);
+		for (size_t i = first; i < last; i += 8)
+		{
+			integrate8(&PositionX[i], &VelocityX[i], dt);
+			integrate8(&PositionY[i], &VelocityY[i], dt);
+			integrate8(&PositionZ[i], &VelocityZ[i], dt);
+			integrate8(&Roll[i], &RollSpeed[i], dt);
+
+			__m256 age = _mm256_add_ps(_mm256_loadu_ps(&Age[i]), dt);
+			_mm256_storeu_ps(&Age[i], age);
+			int expiredBits = _mm256_movemask_ps(_mm256_cmp_ps(age, _mm256_loadu_ps(&Lifetime[i]), _CMP_GE_OQ));
+			reportExpired(i, expiredBits, expire);
+		}
+#elif defined(PARTICLE_SSE)
+		const __m128 dt = _mm_set1_ps(deltaTime);
+		for (size_t i = first; i < last; i += 4)
+		{
+			integrate4(&PositionX[i], &VelocityX[i], dt);
+			integrate4(&PositionY[i], &VelocityY[i], dt);
+			integrate4(&PositionZ[i], &VelocityZ[i], dt);
+			integrate4(&Roll[i], &RollSpeed[i], dt);
+
+			__m128 age = _mm_add_ps(_mm_loadu_ps(&Age[i]), dt);
+			_mm_storeu_ps(&Age[i], age);
+			int expiredBits = _mm_movemask_ps(_mm_cmpge_ps(age, _mm_loadu_ps(&Lifetime[i])));
+			reportExpired(i, expiredBits, expire);
+		}
+#else
+		for (size_t i = first; i < last; i++)
+		{
+			PositionX[i] += VelocityX[i] * deltaTime;
+			PositionY[i] += VelocityY[i] * deltaTime;
+			PositionZ[i] += VelocityZ[i] * deltaTime;
+			Roll[i] += RollSpeed[i] * deltaTime;
+
+			Age[i] += deltaTime;
+			if (Age[i] >= Lifetime[i])
+				expire(i);
+		}
+#endif
+	}
+
+	// Moves the positions of [first, last) back into the box at min of the given size, so a
+	// particle leaving through one face comes back through the opposite one. first and last must
+	// be multiples of Lanes.
+	void wrap(size_t first, size_t last, const glm::vec3& min, const glm::vec3& size)
+	{
+#if defined(PARTICLE_AVX2)
+		for (size_t i = first; i < last; i += 8)
+		{
+			wrap8(&PositionX[i], min.x, size.x);
+			wrap8(&PositionY[i], min.y, size.y);
+			wrap8(&PositionZ[i], min.z, size.z);
+		}
+#elif defined(PARTICLE_SSE)
+		for (size_t i = first; i < last; i += 4)
+		{
+			wrap4(&PositionX[i], min.x, size.x);
+			wrap4(&PositionY[i], min.y, size.y);
+			wrap4(&PositionZ[i], min.z, size.z);
+		}
+#else
+		for (size_t i = first; i < last; i++)
+		{
+			PositionX[i] -= size.x * std::floor((PositionX[i] - min.x) / size.x);
+			PositionY[i] -= size.y * std::floor((PositionY[i] - min.y) / size.y);
+			PositionZ[i] -= size.z * std::floor((PositionZ[i] - min.z) / size.z);
+		}
+#endif
+	}
+
+	// Tests the live particles of [first, last) against collision's height field, one lookup each,
+	// and applies its response. Dying particles go to die(index), which is expected to kill the
+	// slot. first and last must be multiples of Lanes.
+	template<typename Die>
+	void collide(size_t first, size_t last, const ParticleCollision& collision, Die die)
+	{
+		const HeightField& field = *collision.Field;
+		if (collision.Response == CollisionResponse::None || field.empty())
+			return;
+
+		// Particles are tested in the field's space, hits are lifted along its up axis in the world
+		const glm::mat4 fieldFromWorld = glm::affineInverse(collision.FieldTransform);
+		const glm::vec3 up = glm::vec3(collision.FieldTransform[1]);
+
+#if defined(PARTICLE_AVX2)
+		const __m256 minX = _mm256_set1_ps(field.Min.x);
+		const __m256 minZ = _mm256_set1_ps(field.Min.y);
+		const __m256 inverseCell = _mm256_set1_ps(1.0f / field.CellSize);
+		const __m256 width = _mm256_set1_ps((float)field.Width);
+		const __m256 depth = _mm256_set1_ps((float)field.Depth);
+		const __m256 thickness = _mm256_set1_ps(collision.Thickness);
+		for (size_t i = first; i < last; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(&PositionX[i]);
+			__m256 y = _mm256_loadu_ps(&PositionY[i]);
+			__m256 z = _mm256_loadu_ps(&PositionZ[i]);
+			__m256 fieldY = transformRow8(fieldFromWorld, 1, x, y, z);
+			__m256 cellX = _mm256_mul_ps(_mm256_sub_ps(transformRow8(fieldFromWorld, 0, x, y, z), minX), inverseCell);
+			__m256 cellZ = _mm256_mul_ps(_mm256_sub_ps(transformRow8(fieldFromWorld, 2, x, y, z), minZ), inverseCell);
+			__m256 inside = _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(cellX, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(cellX, width, _CMP_LT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(cellZ, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(cellZ, depth, _CMP_LT_OQ)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_loadu_ps(&Lifetime[i]), _mm256_set1_ps(FLT_MAX), _CMP_LT_OQ));
+			if (_mm256_movemask_ps(inside) == 0)
+				continue;
+
+			// Lanes outside the grid gather cell 0 and are masked off afterwards
+			__m256i cell = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(cellZ), _mm256_set1_epi32(field.Width)), _mm256_cvttps_epi32(cellX));
+			cell = _mm256_and_si256(cell, _mm256_castps_si256(inside));
+			__m256 height = _mm256_i32gather_ps(field.Heights.data(), cell, 4);
+
+			__m256 hit = _mm256_and_ps(_mm256_cmp_ps(fieldY, height, _CMP_LT_OQ), _mm256_cmp_ps(fieldY, _mm256_sub_ps(height, thickness), _CMP_GT_OQ));
+			hit = _mm256_and_ps(hit, inside);
+			int hitBits = _mm256_movemask_ps(hit);
+			if (hitBits != 0)
+			{
+				alignas(32) float laneLifts[8];
+				_mm256_store_ps(laneLifts, _mm256_sub_ps(height, fieldY));
+				respond(i, hitBits, laneLifts, up, collision.Response, die);
+			}
+		}
+#elif defined(PARTICLE_SSE)
+		const __m128 minX = _mm_set1_ps(field.Min.x);
+		const __m128 minZ = _mm_set1_ps(field.Min.y);
+		const __m128 inverseCell = _mm_set1_ps(1.0f / field.CellSize);
+		const __m128 width = _mm_set1_ps((float)field.Width);
+		const __m128 depth = _mm_set1_ps((float)field.Depth);
+		const __m128 thickness = _mm_set1_ps(collision.Thickness);
+		for (size_t i = first; i < last; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&PositionX[i]);
+			__m128 y = _mm_loadu_ps(&PositionY[i]);
+			__m128 z = _mm_loadu_ps(&PositionZ[i]);
+			__m128 fieldY = transformRow4(fieldFromWorld, 1, x, y, z);
+			__m128 cellX = _mm_mul_ps(_mm_sub_ps(transformRow4(fieldFromWorld, 0, x, y, z), minX), inverseCell);
+			__m128 cellZ = _mm_mul_ps(_mm_sub_ps(transformRow4(fieldFromWorld, 2, x, y, z), minZ), inverseCell);
+			__m128 inside = _mm_and_ps(
+				_mm_and_ps(_mm_cmpge_ps(cellX, _mm_setzero_ps()), _mm_cmplt_ps(cellX, width)),
+				_mm_and_ps(_mm_cmpge_ps(cellZ, _mm_setzero_ps()), _mm_cmplt_ps(cellZ, depth)));
+			inside = _mm_and_ps(inside, _mm_cmplt_ps(_mm_loadu_ps(&Lifetime[i]), _mm_set1_ps(FLT_MAX)));
+			int insideBits = _mm_movemask_ps(inside);
+			if (insideBits == 0)
+				continue;
+
+			// SSE2 has no 32 bit multiply or gather. The cell index is exact in float for any grid
+			// under MaxCells, and lanes outside the grid load cell 0.
+			__m128 cellFloat = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(cellZ)), width), _mm_cvtepi32_ps(_mm_cvttps_epi32(cellX)));
+			alignas(16) int32_t cell[4];
+			_mm_store_si128((__m128i*)cell, _mm_and_si128(_mm_cvttps_epi32(cellFloat), _mm_castps_si128(inside)));
+			const float* heights = field.Heights.data();
+			__m128 height = _mm_setr_ps(heights[cell[0]], heights[cell[1]], heights[cell[2]], heights[cell[3]]);
+
+			__m128 hit = _mm_and_ps(_mm_cmplt_ps(fieldY, height), _mm_cmpgt_ps(fieldY, _mm_sub_ps(height, thickness)));
+			int hitBits = _mm_movemask_ps(hit) & insideBits;
+			if (hitBits != 0)
+			{
+				alignas(16) float laneLifts[4];
+				_mm_store_ps(laneLifts, _mm_sub_ps(height, fieldY));
+				respond(i, hitBits, laneLifts, up, collision.Response, die);
+			}
+		}
+#else
+		for (size_t i = first; i < last; i++)
+		{
+			if (Lifetime[i] == FLT_MAX)
+				continue;
+
+			glm::vec3 fieldPosition = glm::vec3(fieldFromWorld * glm::vec4(PositionX[i], PositionY[i], PositionZ[i], 1.0f));
+			float height = field.sample(fieldPosition.x, fieldPosition.z);
+			if (fieldPosition.y < height && fieldPosition.y > height - collision.Thickness)
+			{
+				float lift = height - fieldPosition.y;
+				respond(i, 1, &lift, up, collision.Response, die);
+			}
+		}
+#endif
+	}
+
+	// Sortable keys of the view space depth of [first, last) to keys[first, last), given the third
+	// row of the view matrix. Ascending keys run back to front. first and last must be multiples
+	// of Lanes.
+	void writeDepthKeys(size_t first, size_t last, const glm::vec4& depthRow, uint32_t* keys) const
+	{
+#ifdef PARTICLE_SSE
+		for (size_t i = first; i < last; i += 4)
+		{
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&PositionX[i]), _mm_set1_ps(depthRow.x)), _mm_set1_ps(depthRow.w));
+			z = _mm_add_ps(z, _mm_mul_ps(_mm_loadu_ps(&PositionY[i]), _mm_set1_ps(depthRow.y)));
+			z = _mm_add_ps(z, _mm_mul_ps(_mm_loadu_ps(&PositionZ[i]), _mm_set1_ps(depthRow.z)));
+
+			// Flip every bit of negative floats and the sign of positive ones, so keys order as floats do
+			__m128i bits = _mm_castps_si128(z);
+			__m128i flip = _mm_or_si128(_mm_srai_epi32(bits, 31), _mm_set1_epi32((int)0x80000000));
+			_mm_storeu_si128((__m128i*)&keys[i], _mm_xor_si128(bits, flip));
+		}
+#else
+		for (size_t i = first; i < last; i++)
+		{
+			float z = depthRow.x * PositionX[i] + depthRow.y * PositionY[i] + depthRow.z * PositionZ[i] + depthRow.w;
+			uint32_t bits;
+			std::memcpy(&bits, &z, sizeof(bits));
+			keys[i] = bits ^ ((bits & 0x80000000u) != 0 ? 0xFFFFFFFFu : 0x80000000u);
+		}
+#endif
+	}
+
+	// Writes the instances of [first, last) to out[first, last), four at a time through a register
+	// transpose. With order, position i takes slot order[i] instead, e.g. from sorted depth keys.
+	// Roll is wrapped to [-pi, pi] to keep its half float precise. first and last must be
+	// multiples of Lanes.
+	void writeInstances(size_t first, size_t last, ParticleInstance* out, const uint32_t* order = nullptr) const
+	{
+		write(first, last, out, order, nullptr, glm::vec3(0.0f));
+	}
+
+	// As above, thinned out around viewer. Dropped particles are written with no size.
+	void writeInstances(size_t first, size_t last, ParticleInstance* out, const DensityFalloff& falloff, const glm::vec3& viewer, const uint32_t* order = nullptr) const
+	{
+		write(first, last, out, order, &falloff, viewer);
+	}
+
+private:
+	static constexpr float TwoPi = 6.28318531f;
+	static constexpr float InverseTwoPi = 1.0f / 6.28318531f;
+
+	size_t count;
+
+	void write(size_t first, size_t last, ParticleInstance* out, const uint32_t* order, const DensityFalloff* falloff, const glm::vec3& viewer) const
+	{
+#ifdef PARTICLE_SSE
+		for (size_t i = first; i < last; i += 4)
+		{
+			__m128 px = load4(PositionX, order, i);
+			__m128 py = load4(PositionY, order, i);
+			__m128 pz = load4(PositionZ, order, i);
+			__m128 s = load4(Size, order, i);
+			if (falloff != nullptr)
+			{
+				__m128 rank = order != nullptr
+					? _mm_setr_ps(getRank(order[i]), getRank(order[i + 1]), getRank(order[i + 2]), getRank(order[i + 3]))
+					: _mm_setr_ps(getRank(i), getRank(i + 1), getRank(i + 2), getRank(i + 3));
+				s = _mm_and_ps(s, keepMask4(rank, px, py, pz, *falloff, viewer));
+			}
+
+			__m128 roll = load4(Roll, order, i);
+			__m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(roll, _mm_set1_ps(InverseTwoPi))));
+			roll = _mm_sub_ps(roll, _mm_mul_ps(turns, _mm_set1_ps(TwoPi)));
+
+			__m128 sizeRoll = _mm_castsi128_ps(_mm_or_si128(toHalf4(s), _mm_slli_epi32(toHalf4(roll), 16)));
+			_MM_TRANSPOSE4_PS(px, py, pz, sizeRoll);
+
+			float* dst = (float*)&out[i];
+			_mm_storeu_ps(dst + 0, px);
+			_mm_storeu_ps(dst + 4, py);
+			_mm_storeu_ps(dst + 8, pz);
+			_mm_storeu_ps(dst + 12, sizeRoll);
+		}
+#else
+		for (size_t i = first; i < last; i++)
+		{
+			size_t slot = order != nullptr ? order[i] : i;
+			glm::vec3 position(PositionX[slot], PositionY[slot], PositionZ[slot]);
+			bool keep = falloff == nullptr || getRank(slot) < getDensity(glm::length(position - viewer), *falloff);
+			float roll = Roll[slot] - TwoPi * std::round(Roll[slot] * InverseTwoPi);
+			out[i].Position = position;
+			out[i].SizeRoll = glm::packHalf2x16(glm::vec2(keep ? Size[slot] : 0.0f, roll));
+		}
+#endif
+	}
+
+	// Fixed per slot and evenly spread in [0, 1), a Weyl sequence over the golden ratio
+	static float getRank(size_t i)
+	{
+		return (((uint32_t)i * 0x9E3779B9u) >> 8) * (1.0f / 16777216.0f);
+	}
+
+	static float getDensity(float distance, const DensityFalloff& falloff)
+	{
+		float t = glm::clamp((distance - falloff.Near) / (falloff.Far - falloff.Near), 0.0f, 1.0f);
+		return 1.0f + t * (falloff.FarDensity - 1.0f);
+	}
+
+	std::vector<std::vector<float>*> streams()
+	{
+		return
+		{
+			&PositionX, &PositionY, &PositionZ,
+			&VelocityX, &VelocityY, &VelocityZ,
+			&Roll, &RollSpeed,
+			&Size, &Age, &Lifetime
+		};
+	}
+
+	// Expiry is rare, so the common all-clear mask costs one branch
+	template<typename Expire>
+	static void reportExpired(size_t first, int expiredBits, Expire& expire)
+	{
+		while (expiredBits != 0)
+		{
+			int lane = 0;
+			while ((expiredBits & (1 << lane)) == 0)
+				lane++;
+
+			expire(first + lane);
+			expiredBits &= expiredBits - 1;
+		}
+	}
+
+	// Collisions are the exception, lanes that hit are handled one by one. lifts are how far
+	// along up each lane moves to reach the surface.
+	template<typename Die>
+	void respond(size_t first, int hitBits, const float* lifts, const glm::vec3& up, CollisionResponse response, Die& die)
+	{
+		while (hitBits != 0)
+		{
+			int lane = 0;
+			while ((hitBits & (1 << lane)) == 0)
+				lane++;
+			hitBits &= hitBits - 1;
+
+			size_t i = first + lane;
+			if (response == CollisionResponse::Die)
+			{
+				die(i);
+				continue;
+			}
+
+			PositionX[i] += up.x * lifts[lane];
+			PositionY[i] += up.y * lifts[lane];
+			PositionZ[i] += up.z * lifts[lane];
+			if (response == CollisionResponse::Stick)
+			{
+				VelocityX[i] = VelocityY[i] = VelocityZ[i] = 0.0f;
+				RollSpeed[i] = 0.0f;
+			}
+		}
+	}
+
+#ifdef PARTICLE_SSE
+	// Float to half rounded to nearest even. Over the normal half range this matches
+	// glm::packHalf2x16 except on exact ties, which glm rounds away from zero. Magnitudes below the
+	// smallest normal half flush to zero, and anything past the largest half, NaN included, clamps
+	// to it instead of becoming infinite.
+	static __m128i toHalf4(__m128 value)
+	{
+		const __m128i largest = _mm_set1_epi32(0x477FE000); // 65504
+
+		__m128i bits = _mm_castps_si128(value);
+		__m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+		__m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+		__m128i over = _mm_cmpgt_epi32(magnitude, largest);
+		magnitude = _mm_or_si128(_mm_and_si128(over, largest), _mm_andnot_si128(over, magnitude));
+		__m128i normal = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x387FFFFF));
+
+		// Adding just under half an ulp, plus one when the kept bit is odd, breaks ties to even
+		__m128i odd = _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1));
+		__m128i rounded = _mm_add_epi32(_mm_sub_epi32(magnitude, _mm_set1_epi32(112 << 23)), _mm_add_epi32(_mm_set1_epi32(0xFFF), odd));
+		__m128i half = _mm_srli_epi32(rounded, 13);
+		return _mm_or_si128(sign, _mm_and_si128(half, normal));
+	}
+
+	static __m128 load4(const std::vector<float>& stream, const uint32_t* order, size_t i)
+	{
+		if (order == nullptr)
+			return _mm_loadu_ps(&stream[i]);
+
+		return _mm_setr_ps(stream[order[i]], stream[order[i + 1]], stream[order[i + 2]], stream[order[i + 3]]);
+	}
+
+	static __m128 keepMask4(__m128 rank, __m128 px, __m128 py, __m128 pz, const DensityFalloff& falloff, const glm::vec3& viewer)
+	{
+		__m128 dx = _mm_sub_ps(px, _mm_set1_ps(viewer.x));
+		__m128 dy = _mm_sub_ps(py, _mm_set1_ps(viewer.y));
+		__m128 dz = _mm_sub_ps(pz, _mm_set1_ps(viewer.z));
+		__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+		__m128 t = _mm_mul_ps(_mm_sub_ps(distance, _mm_set1_ps(falloff.Near)), _mm_set1_ps(1.0f / (falloff.Far - falloff.Near)));
+		t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		__m128 density = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(t, _mm_set1_ps(falloff.FarDensity - 1.0f)));
+		return _mm_cmplt_ps(rank, density);
+	}
+#endif
+
+#if defined(PARTICLE_AVX2)
+	static void wrap8(float* value, float min, float size)
+	{
+		__m256 v = _mm256_loadu_ps(value);
+		__m256 cells = _mm256_floor_ps(_mm256_mul_ps(_mm256_sub_ps(v, _mm256_set1_ps(min)), _mm256_set1_ps(1.0f / size)));
+		_mm256_storeu_ps(value, _mm256_sub_ps(v, _mm256_mul_ps(cells, _mm256_set1_ps(size))));
+	}
+
+	static void integrate8(float* value, const float* rate, __m256 dt)
+	{
+		_mm256_storeu_ps(value, _mm256_add_ps(_mm256_loadu_ps(value), _mm256_mul_ps(_mm256_loadu_ps(rate), dt)));
+	}
+
+	// One coordinate of the affine transform of eight points
+	static __m256 transformRow8(const glm::mat4& m, int row, __m256 x, __m256 y, __m256 z)
+	{
+		__m256 result = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0][row]), x), _mm256_set1_ps(m[3][row]));
+		result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_set1_ps(m[1][row]), y));
+		return _mm256_add_ps(result, _mm256_mul_ps(_mm256_set1_ps(m[2][row]), z));
+	}
+#elif defined(PARTICLE_SSE)
+	// SSE2 has no floor, truncation is corrected where it rounded up
+	static void wrap4(float* value, float min, float size)
+	{
+		__m128 v = _mm_loadu_ps(value);
+		__m128 x = _mm_mul_ps(_mm_sub_ps(v, _mm_set1_ps(min)), _mm_set1_ps(1.0f / size));
+		__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+		__m128 cells = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+		_mm_storeu_ps(value, _mm_sub_ps(v, _mm_mul_ps(cells, _mm_set1_ps(size))));
+	}
+
+	static void integrate4(float* value, const float* rate, __m128 dt)
+	{
+		_mm_storeu_ps(value, _mm_add_ps(_mm_loadu_ps(value), _mm_mul_ps(_mm_loadu_ps(rate), dt)));
+	}
+
+	static __m128 transformRow4(const glm::mat4& m, int row, __m128 x, __m128 y, __m128 z)
+	{
+		__m128 result = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][row]), x), _mm_set1_ps(m[3][row]));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(m[1][row]), y));
+		return _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(m[2][row]), z));
+	}
+#endif
+};
@@ -1,42 +1,375 @@
 #pragma once
-#include "particle.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "particlestore.h"
+#include "particlebudget.h"
+#include "randomstream.h"
+#include "jobsystem.h"
+#include "radixsort.h"
+#include "particlebillboard.h"
 #include "assetmanager.h"
-#include "shadermanager.h"
+#include "glstate.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <vector>
 
+// Keeps a ParticleSystem's particles in a box of half size Extents around Center, usually the
+// camera. Particles wrap around the faces of the box as it moves, so the simulated count does
+// not depend on the size of the level, and thin out with distance from Center.
+struct WeatherVolume
+{
+	bool Enabled;
+	glm::vec3 Center;
+	glm::vec3 Extents;
+	DensityFalloff Density;
+};
+
+// Emitter over a fixed pool of ParticleStore slots, drawn as billboards with one instanced call.
+// The quad and the 16 byte instance stream are shared by every particle of the system.
+// Particles are spawned at SpawnRate, in repeating bursts or by burst(), within what the pool
+// and the shared ParticleBudget allow. Expired particles are killed in place and their slots go
+// on a free list per chunk, reused before the high water mark grows. Only slots below the mark
+// are simulated and drawn, and a system with nothing alive and nothing to spawn does no work.
+// Updates run on the JobSystem in fixed chunks. Each chunk integrates its particles, collides
+// them with the Collision height field if there is one, and writes their instances straight
+// into the mapped instance buffer, so draw() has nothing left to copy.
+// With SortInterval set draw() writes them instead, back to front by a RadixSort of view depth.
+// Spawns draw from a RandomStream seeded by system and update, which makes the simulation
+// reproducible whatever the thread count or scheduling.
 class ParticleSystem
 {
 public:
-	std::vector<Particle> particles;
+	static const int InstanceLocation = 4;
+	static const size_t ChunkSize = 4096;
+
+	ParticleStore Particles;
+	float SpawnRate; // Particles per second
+	uint32_t BurstCount; // Spawned every BurstInterval seconds, 0 for no bursts
+	float BurstInterval;
+	WeatherVolume Weather;
+	ParticleCollision Collision; // No Field for none
+	ParticleBillboard Billboard;
+	uint32_t SortInterval; // Draws back to front, sorted every SortInterval draws, 0 for slot order
+
+	ParticleSystem(int capacity, uint64_t seed = 1)
+	{
+		SpawnRate = 0.0f;
+		BurstCount = 0;
+		BurstInterval = 1.0f;
+		SortInterval = 0;
+		Weather = { false, glm::vec3(0.0f), glm::vec3(8.0f, 6.0f, 8.0f), { 4.0f, 8.0f, 0.25f } };
+		Collision = { nullptr, CollisionResponse::Stick, 0.5f, glm::mat4(1.0f) };
+
+		this->seed = seed;
+		updateIndex = 0;
+		mappedInstances = nullptr;
+		spawnCarry = 0.0f;
+		burstTimer = 0.0f;
+		pendingSpawns = 0;
+		highWater = 0;
+		liveCount = 0;
+		updatedSize = 0;
+		drawIndex = 0;
+
+		quad = AssetManager::getInstance().getVertexArrayObject("Quad");
+
+		Particles.resize(capacity);
+		freeLists.resize((Particles.getPaddedSize() + ChunkSize - 1) / ChunkSize);
+		for (std::vector<uint32_t>& freeList : freeLists)
+			freeList.reserve(ChunkSize);
+
+		createInstanceVAO();
+	}
 
-	ParticleSystem(int size)
+	~ParticleSystem()
 	{
-		AssetManager& assetManager = AssetManager::getInstance();
-		ShaderManager& shaderManager = ShaderManager::getInstance();
+		ParticleBudget::getInstance().release(liveCount);
+	}
+
+	ParticleSystem(ParticleSystem const&) = delete;
+	void operator=(ParticleSystem const&) = delete;
+
+	// Spawns count particles on the next update, on top of the rate and repeating bursts
+	void burst(uint32_t count)
+	{
+		pendingSpawns += count;
+	}
 
-		VertexArrayObject quad = assetManager.getVertexArrayObject("Quad");
-		Shader particleShader = shaderManager.getShader("UnlitShader");
-		Material particleMaterial;
-		particleMaterial.setShader(particleShader);
+	size_t getLiveCount() const
+	{
+		return liveCount;
+	}
+
+	// Blocking convenience over beginUpdate
+	void update(float deltaTime)
+	{
+		JobCounter counter;
+		beginUpdate(deltaTime, counter);
+		JobSystem::getInstance().wait(counter);
+	}
 
-		for (int i = 0; i < size; i++)
+	// Spawns on the calling thread, then queues this system's chunks against counter and returns.
+	// Several systems may share one counter to update concurrently. Call from the GL thread, and
+	// wait on counter before draw(). Unsorted systems write their instances in the same jobs.
+	void beginUpdate(float deltaTime, JobCounter& counter)
+	{
+		reclaim();
+		spawn(takeSpawnCount(deltaTime));
+
+		size_t padded = (highWater + ParticleStore::Lanes - 1) & ~(ParticleStore::Lanes - 1);
+		if (padded == 0)
+			return;
+
+		if (mappedInstances == nullptr)
 		{
-			particles.push_back(Particle(quad, particleMaterial));
+			GLsizeiptr size = padded * sizeof(ParticleInstance);
+			glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+			glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+
+			// Freshly orphaned, so no draw can still be reading it
+			mappedInstances = (ParticleInstance*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
 		}
+
+		// Read by the jobs, left alone until the next update
+		updateIndex++;
+		updatedSize = padded;
+		updatedWeather = Weather;
+		updatedCollision = Collision;
+		JobSystem::getInstance().dispatch(getChunkCount(),
+			[this, deltaTime](uint32_t chunk) { updateChunk(chunk, deltaTime); }, counter);
 	}
 
-	void update(float deltaTime)
+	// One instanced draw for the whole system, of whatever the last update wrote. Dead slots
+	// below the high water mark are drawn at zero size. Sorted systems write their instances
+	// here, on the JobSystem, and wait for them.
+	void draw(const glm::mat4& view, const glm::mat4& projection)
+	{
+		if (highWater == 0 || updateIndex == 0)
+			return;
+
+		if (mappedInstances != nullptr)
+		{
+			if (SortInterval > 0)
+				writeSorted(view);
+
+			glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			mappedInstances = nullptr;
+		}
+
+		Billboard.begin(view, projection);
+		GLState::getInstance().bindVertexArray(instanceVAO);
+		glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)quad.IndicesSize, GL_UNSIGNED_INT, 0, (GLsizei)updatedSize);
+		Billboard.end();
+	}
+
+private:
+	VertexArrayObject quad;
+	unsigned int instanceVAO;
+	unsigned int instanceBuffer;
+	ParticleInstance* mappedInstances;
+	uint64_t seed;
+	uint64_t updateIndex;
+	float spawnCarry;
+	float burstTimer;
+	uint32_t pendingSpawns;
+	size_t highWater;
+	size_t liveCount;
+	std::vector<std::vector<uint32_t>> freeLists;
+	size_t updatedSize;
+	WeatherVolume updatedWeather;
+	ParticleCollision updatedCollision;
+	RadixSort depthSort;
+	std::vector<uint32_t> depthKeys;
+	std::vector<uint32_t> drawOrder;
+	uint64_t drawIndex;
+
+	uint32_t getChunkCount() const
+	{
+		return (uint32_t)((updatedSize + ChunkSize - 1) / ChunkSize);
+	}
+
+	// Hands last update's kills back to the budget, and rewinds an emptied pool
+	void reclaim()
+	{
+		size_t freeCount = 0;
+		for (const std::vector<uint32_t>& freeList : freeLists)
+			freeCount += freeList.size();
+
+		size_t live = highWater - freeCount;
+		ParticleBudget::getInstance().release(liveCount - live);
+		liveCount = live;
+
+		if (liveCount == 0)
+		{
+			highWater = 0;
+			for (std::vector<uint32_t>& freeList : freeLists)
+				freeList.clear();
+		}
+	}
+
+	uint32_t takeSpawnCount(float deltaTime)
+	{
+		spawnCarry += SpawnRate * deltaTime;
+		uint32_t count = (uint32_t)spawnCarry;
+		spawnCarry -= (float)count;
+
+		if (BurstCount > 0)
+		{
+			burstTimer -= deltaTime;
+			if (burstTimer <= 0.0f)
+			{
+				count += BurstCount;
+				burstTimer = std::max(burstTimer + BurstInterval, 0.0f);
+			}
+		}
+
+		count += pendingSpawns;
+		pendingSpawns = 0;
+		return count;
+	}
+
+	// Whatever the pool or the budget cannot take is dropped, not deferred
+	void spawn(uint32_t count)
 	{
-		for (Particle& particle : particles)
-			particle.update(deltaTime);
+		size_t capacity = Particles.size();
+		size_t available = capacity - liveCount;
+		size_t granted = ParticleBudget::getInstance().acquire(std::min((size_t)count, available));
+		if (granted == 0)
+			return;
+
+		glm::vec3 boxMin = Weather.Enabled ? Weather.Center - Weather.Extents : glm::vec3(2.0f, -4.0f, -12.0f);
+		glm::vec3 boxMax = Weather.Enabled ? Weather.Center + Weather.Extents : glm::vec3(10.0f, 4.0f, 0.0f);
+
+		liveCount += granted;
+		RandomStream random(RandomStream::makeSeed(seed, updateIndex, ~0ull));
+		size_t chunk = 0;
+		for (size_t n = 0; n < granted; n++)
+		{
+			while (chunk < freeLists.size() && freeLists[chunk].empty())
+				chunk++;
+
+			size_t i;
+			if (chunk < freeLists.size())
+			{
+				i = freeLists[chunk].back();
+				freeLists[chunk].pop_back();
+			}
+			else
+			{
+				i = highWater++;
+			}
+
+			emit(i, random, boxMin, boxMax);
+		}
 	}
 
-	void draw(const glm::mat4& viewProjection)
+	void updateChunk(uint32_t chunk, float deltaTime)
 	{
-		for (const Particle& particle : particles)
+		size_t first = chunk * ChunkSize;
+		size_t last = std::min(first + ChunkSize, updatedSize);
+		const WeatherVolume& weather = updatedWeather;
+
+		std::vector<uint32_t>& freeList = freeLists[chunk];
+		auto expire = [&](size_t i)
+		{
+			Particles.kill(i);
+			freeList.push_back((uint32_t)i);
+		};
+		Particles.update(first, last, deltaTime, expire);
+
+		if (weather.Enabled)
+			Particles.wrap(first, last, weather.Center - weather.Extents, weather.Extents * 2.0f);
+
+		// After the wrap, which may carry particles below a surface
+		if (updatedCollision.Field != nullptr)
+			Particles.collide(first, last, updatedCollision, expire);
+
+		if (mappedInstances != nullptr && SortInterval == 0)
+			writeInstances(first, last, nullptr);
+	}
+
+	void writeInstances(size_t first, size_t last, const uint32_t* order)
+	{
+		if (updatedWeather.Enabled)
+			Particles.writeInstances(first, last, mappedInstances, updatedWeather.Density, updatedWeather.Center, order);
+		else
+			Particles.writeInstances(first, last, mappedInstances, order);
+	}
+
+	// Slots keep their place, so between sorts the last order stays valid and only goes stale as
+	// particles move. It is rebuilt right away when the pool grew or was rewound.
+	void writeSorted(const glm::mat4& view)
+	{
+		JobSystem& jobSystem = JobSystem::getInstance();
+		uint32_t chunkCount = getChunkCount();
+
+		if (drawOrder.size() != updatedSize || drawIndex % SortInterval == 0)
+		{
+			depthKeys.resize(updatedSize);
+			drawOrder.resize(updatedSize);
+			glm::vec4 depthRow(view[0][2], view[1][2], view[2][2], view[3][2]);
+
+			JobCounter keyed;
+			jobSystem.dispatch(chunkCount, [&](uint32_t chunk)
+			{
+				size_t first = chunk * ChunkSize;
+				size_t last = std::min(first + ChunkSize, updatedSize);
+				Particles.writeDepthKeys(first, last, depthRow, depthKeys.data());
+				for (size_t i = first; i < last; i++)
+					drawOrder[i] = (uint32_t)i;
+			}, keyed);
+			jobSystem.wait(keyed);
+
+			depthSort.sort(depthKeys, drawOrder);
+		}
+		drawIndex++;
+
+		JobCounter written;
+		jobSystem.dispatch(chunkCount, [&](uint32_t chunk)
+		{
+			size_t first = chunk * ChunkSize;
+			writeInstances(first, std::min(first + ChunkSize, updatedSize), drawOrder.data());
+		}, written);
+		jobSystem.wait(written);
+	}
+
+	// Snow drifting down and along the wind, in the weather volume or a fixed box of the scene
+	void emit(size_t i, RandomStream& random, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		Particles.PositionX[i] = random.range(boxMin.x, boxMax.x);
+		Particles.PositionY[i] = random.range(boxMin.y, boxMax.y);
+		Particles.PositionZ[i] = random.range(boxMin.z, boxMax.z);
+		Particles.VelocityX[i] = random.range(-3.0f, -1.0f);
+		Particles.VelocityY[i] = random.range(-1.0f, 0.0f);
+		Particles.VelocityZ[i] = random.range(0.0f, 2.0f);
+		Particles.RollSpeed[i] = random.range(-0.25f, 0.25f);
+		Particles.Size[i] = 0.1f;
+		Particles.Age[i] = 0.0f;
+		Particles.Lifetime[i] = random.range(5.0f, 10.0f);
+	}
+
+	// Shares the quad's positions and indices and adds the per instance stream
+	void createInstanceVAO()
+	{
+		glGenVertexArrays(1, &instanceVAO);
+		GLState::getInstance().bindVertexArray(instanceVAO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, quad.VertexPositionID);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad.IndicesID);
+
+		glGenBuffers(1, &instanceBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glVertexAttribPointer(InstanceLocation, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, Position));
+		glVertexAttribIPointer(InstanceLocation + 1, 1, GL_UNSIGNED_INT, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, SizeRoll));
+		for (int location = InstanceLocation; location < InstanceLocation + 2; location++)
 		{
-			particle.draw(viewProjection);
+			glVertexAttribDivisor(location, 1);
+			glEnableVertexAttribArray(location);
 		}
 	}
-};
\ No newline at end of file
+};
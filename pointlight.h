@@ -30,13 +30,13 @@ public:
 
 	void setOtherShaderUniforms(const Shader& shader, int index) const
 	{
-		std::string strUniform = "u_pointLights[" + std::to_string(index) + "]";
-		shader.setVec3((strUniform + ".position").c_str(), Position);
-		shader.setVec3((strUniform + ".ambient").c_str(), Ambient);
-		shader.setVec3((strUniform + ".diffuse").c_str(), Diffuse);
-		shader.setVec3((strUniform + ".specular").c_str(), Specular);
-		shader.setFloat((strUniform + ".constant").c_str(), Constant);
-		shader.setFloat((strUniform + ".linear").c_str(), Linear);
-		shader.setFloat((strUniform + ".quadratic").c_str(), Quadratic);
+		int location = UniformLocation::PointLights + index * UniformLocation::PointLightStride;
+		shader.setVec3(location + 0, Position);
+		shader.setVec3(location + 1, Ambient);
+		shader.setVec3(location + 2, Diffuse);
+		shader.setVec3(location + 3, Specular);
+		shader.setFloat(location + 4, Constant);
+		shader.setFloat(location + 5, Linear);
+		shader.setFloat(location + 6, Quadratic);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Stores linked programs with glGetProgramBinary so warm starts skip GLSL compilation.
+// Entries are keyed by the preprocessed sources and the driver identity; a binary the driver
+// rejects (driver update, different GPU) is simply ignored and overwritten after recompiling.
+class ProgramBinaryCache
+{
+public:
+	static ProgramBinaryCache& getInstance()
+	{
+		static ProgramBinaryCache instance;
+		return instance;
+	}
+
+	bool isEnabled() const
+	{
+		return enabled;
+	}
+
+	uint64_t makeKey(const std::string& vertexCode, const std::string& fragmentCode) const
+	{
+		uint64_t hash = 14695981039346656037ull;
+		hash = fnv1a(hash, driverIdentity);
+		hash = fnv1a(hash, vertexCode);
+		hash = fnv1a(hash, "\n--fragment--\n");
+		hash = fnv1a(hash, fragmentCode);
+		return hash;
+	}
+
+	// Returns a linked program, or 0 when there is no usable binary for the key
+	unsigned int load(uint64_t key) const
+	{
+		if (!enabled)
+			return 0;
+
+		std::ifstream file(getPath(key), std::ios::binary);
+		if (!file.is_open())
+			return 0;
+
+		GLenum format = 0;
+		if (!file.read(reinterpret_cast<char*>(&format), sizeof(format)))
+			return 0;
+
+		std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (binary.empty())
+			return 0;
+
+		unsigned int program = glCreateProgram();
+		glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+
+		int success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glDeleteProgram(program);
+			return 0;
+		}
+
+		return program;
+	}
+
+	// Call before glLinkProgram so the driver keeps a retrievable binary around
+	void prepare(unsigned int program) const
+	{
+		if (enabled)
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	void store(uint64_t key, unsigned int program) const
+	{
+		if (!enabled)
+			return;
+
+		int length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+		std::error_code error;
+		std::filesystem::create_directories(CacheDirectory, error);
+
+		std::ofstream file(getPath(key), std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Cannot write program binary: " << getPath(key) << '\n';
+			return;
+		}
+
+		file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+		file.write(binary.data(), binary.size());
+	}
+
+private:
+	static constexpr const char* CacheDirectory = "shadercache";
+
+	bool enabled;
+	std::string driverIdentity;
+
+	ProgramBinaryCache()
+	{
+		int formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		enabled = formatCount > 0;
+
+		driverIdentity = getString(GL_VENDOR) + '|' + getString(GL_RENDERER) + '|' + getString(GL_VERSION);
+	}
+
+	static std::string getString(GLenum name)
+	{
+		const GLubyte* value = glGetString(name);
+		return value ? reinterpret_cast<const char*>(value) : "";
+	}
+
+	static uint64_t fnv1a(uint64_t hash, const std::string& text)
+	{
+		for (unsigned char c : text)
+		{
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	std::string getPath(uint64_t key) const
+	{
+		std::stringstream path;
+		path << CacheDirectory << '/' << std::hex << key << ".bin";
+		return path.str();
+	}
+
+public:
+	ProgramBinaryCache(ProgramBinaryCache const&) = delete;
+	void operator=(ProgramBinaryCache const&) = delete;
+};
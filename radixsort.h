@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "jobsystem.h"
+
+// Parallel LSD radix sort of 32-bit keys carrying 32-bit values, 8 bits per pass. Each pass
+// counts and scatters blocks of the input on the JobSystem; blocks scatter to consecutive ranges
+// of every bucket in input order, so each pass stays stable. Passes where every key shares the
+// same byte are skipped. Scratch storage is kept between calls.
+class RadixSort
+{
+public:
+	static const size_t BlockSize = 16384;
+
+	// Sorts keys ascending and applies the same permutation to values. Call from one thread at a
+	// time, it waits on the JobSystem until done.
+	void sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values)
+	{
+		size_t count = keys.size();
+		if (count < 2)
+			return;
+
+		uint32_t blockCount = (uint32_t)((count + BlockSize - 1) / BlockSize);
+		histograms.resize(blockCount * 256);
+		scratchKeys.resize(count);
+		scratchValues.resize(count);
+
+		uint32_t* srcKeys = keys.data();
+		uint32_t* srcValues = values.data();
+		uint32_t* dstKeys = scratchKeys.data();
+		uint32_t* dstValues = scratchValues.data();
+		JobSystem& jobSystem = JobSystem::getInstance();
+
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			JobCounter counted;
+			jobSystem.dispatch(blockCount, [&](uint32_t block)
+			{
+				uint32_t* histogram = &histograms[block * 256];
+				std::fill(histogram, histogram + 256, 0);
+
+				size_t last = std::min((block + 1) * BlockSize, count);
+				for (size_t i = block * BlockSize; i < last; i++)
+					histogram[(srcKeys[i] >> shift) & 0xFF]++;
+			}, counted);
+			jobSystem.wait(counted);
+
+			if (!computeOffsets(blockCount, count))
+				continue;
+
+			JobCounter scattered;
+			jobSystem.dispatch(blockCount, [&](uint32_t block)
+			{
+				uint32_t* offsets = &histograms[block * 256];
+				size_t last = std::min((block + 1) * BlockSize, count);
+				for (size_t i = block * BlockSize; i < last; i++)
+				{
+					uint32_t slot = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+					dstKeys[slot] = srcKeys[i];
+					dstValues[slot] = srcValues[i];
+				}
+			}, scattered);
+			jobSystem.wait(scattered);
+
+			std::swap(srcKeys, dstKeys);
+			std::swap(srcValues, dstValues);
+		}
+
+		if (srcKeys != keys.data())
+		{
+			keys.swap(scratchKeys);
+			values.swap(scratchValues);
+		}
+	}
+
+private:
+	std::vector<uint32_t> histograms; // 256 buckets per block
+	std::vector<uint32_t> scratchKeys;
+	std::vector<uint32_t> scratchValues;
+
+	// Turns the block histograms into each block's first slot per bucket. Returns false when a
+	// single bucket holds every key, the pass would not move anything.
+	bool computeOffsets(uint32_t blockCount, size_t count)
+	{
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			uint32_t bucketStart = offset;
+			for (uint32_t block = 0; block < blockCount; block++)
+			{
+				uint32_t& entry = histograms[block * 256 + bucket];
+				uint32_t bucketCount = entry;
+				entry = offset;
+				offset += bucketCount;
+			}
+
+			if (offset - bucketStart == count)
+				return false;
+		}
+
+		return true;
+	}
+};
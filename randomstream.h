@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+
+// SplitMix64. Small, fast and seedable, unlike rand() it holds no global state, so every chunk of
+// parallel work can own a stream and results do not depend on which thread ran what.
+class RandomStream
+{
+public:
+	explicit RandomStream(uint64_t seed)
+	{
+		state = seed;
+	}
+
+	// Independent seeds from a few identifiers, e.g. system, frame and chunk
+	static uint64_t makeSeed(uint64_t a, uint64_t b, uint64_t c)
+	{
+		return mix(mix(mix(a) ^ b) ^ c);
+	}
+
+	uint32_t nextUInt()
+	{
+		state += 0x9E3779B97F4A7C15ull;
+		return (uint32_t)(mix(state) >> 32);
+	}
+
+	// [0, 1), 24 bits of precision
+	float nextFloat()
+	{
+		return (nextUInt() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float range(float min, float max)
+	{
+		return min + (max - min) * nextFloat();
+	}
+
+private:
+	uint64_t state;
+
+	static uint64_t mix(uint64_t z)
+	{
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+};
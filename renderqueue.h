@@ -0,0 +1,497 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "drawable.h"
+#include "world.h"
+#include "shadermanager.h"
+#include "frustum.h"
+#include "occlusionculler.h"
+#include "weightedoit.h"
+
+// Sort key layout, most significant bits first.
+//   Opaque, alpha tested: pass(2) | shader(8) | texture set(12) | material(12) | mesh(12) | depth(18)
+//   Transparent:          pass(2) | inverted depth(18) | shader(8) | texture set(12) | material(12) | mesh(12)
+// Opaque submissions are grouped by state and drawn front-to-back inside each group,
+// transparent ones are strictly back-to-front. Weighted blended transparency does not depend on
+// order, so in that mode transparent submissions use the opaque layout too.
+// Submissions are frustum culled in prepare(), before keys are built, so culled work never reaches the sort.
+// With an OcclusionCuller attached, anything hidden behind the occluders it rendered is dropped too.
+struct RenderCommand
+{
+	const VertexArrayObject* vao;
+	MaterialID material;
+	const glm::mat4* model;
+	float depth;
+	uint32_t cullIndex; // Slot in the frame's FrustumCuller, or PreCulled
+};
+
+struct RenderQueueStats
+{
+	unsigned int Submitted;
+	unsigned int Culled;
+	unsigned int Draws;
+	unsigned int DepthDraws;
+	unsigned int ProgramSwitches;
+	unsigned int VAOSwitches;
+	unsigned int TextureSwitches;
+	unsigned int MaterialUploads;
+};
+
+enum class TransparencyMode
+{
+	Sorted = 0,
+	WeightedBlended
+};
+
+class RenderQueue
+{
+public:
+	static const int DepthBits = 18;
+	static const int ShaderBits = 8;
+	static const int TextureBits = 12;
+	static const int MaterialBits = 12;
+	static const int MeshBits = 12;
+	static const uint32_t PreCulled = 0xFFFFFFFF;
+
+	float MaxDepth;
+	bool FrustumCulling;
+	bool DepthPrePass;
+	TransparencyMode Transparency;
+	const OcclusionCuller* Occlusion;
+	RenderQueueStats Stats;
+
+	RenderQueue()
+	{
+		MaxDepth = 100.0f;
+		FrustumCulling = true;
+		DepthPrePass = false;
+		Transparency = TransparencyMode::Sorted;
+		opaqueEnd = alphaTestedEnd = 0;
+		Occlusion = nullptr;
+		Stats = RenderQueueStats();
+		viewProjection = glm::mat4(1.0f);
+		viewPos = glm::vec3();
+		viewDir = glm::vec3(0.0f, 0.0f, -1.0f);
+	}
+
+	void begin(const glm::mat4& viewProjection, const glm::vec3& viewPos, const glm::vec3& viewDir)
+	{
+		this->viewProjection = viewProjection;
+		this->viewPos = viewPos;
+		this->viewDir = viewDir;
+
+		commands.clear();
+		entries.clear();
+		opaqueEnd = alphaTestedEnd = 0;
+		culler.begin(viewProjection);
+		Stats = RenderQueueStats();
+	}
+
+	// Bounds of each submesh are taken from its VAO and moved into world space with model.
+	// Drawables with a static BVH are culled right away through the hierarchy instead. Both the
+	// drawable and model are referenced until the frame is drawn.
+	void submit(const Drawable& drawable, const glm::mat4& model)
+	{
+		Stats.Submitted += (unsigned int)drawable.VAOs.size();
+
+		if (FrustumCulling && drawable.StaticBVH != nullptr)
+		{
+			queryBVH(*drawable.StaticBVH, model);
+			Stats.Culled += (unsigned int)(drawable.VAOs.size() - visibleSubmeshes.size());
+
+			for (uint32_t i : visibleSubmeshes)
+			{
+				Bounds bounds = drawable.VAOs[i].LocalBounds.transformed(model);
+				commands.push_back({ &drawable.VAOs[i], drawable.Materials[i], &model, glm::dot(bounds.Center - viewPos, viewDir), PreCulled });
+			}
+			return;
+		}
+
+		for (unsigned int i = 0; i < drawable.VAOs.size(); i++)
+		{
+			Bounds bounds = drawable.VAOs[i].LocalBounds.transformed(model);
+			float depth = glm::dot(bounds.Center - viewPos, viewDir);
+
+			commands.push_back({ &drawable.VAOs[i], drawable.Materials[i], &model, depth, culler.add(bounds) });
+		}
+	}
+
+	// Every entity with a mesh, material, transform and world bounds that is not GPU culled. The
+	// bounds are taken as World::updateTransforms() left them, and the world must not change
+	// structurally until the frame is drawn. BVHCulled submeshes are culled through their root's
+	// hierarchy, everything else one by one.
+	void submit(const World& world)
+	{
+		uint32_t required = Component::Transform | Component::RenderMesh | Component::Material | Component::WorldBounds;
+		world.forEach(required, Component::GPUCulled | Component::BVHCulled, [&](const Archetype& archetype)
+		{
+			size_t count = archetype.size();
+			Stats.Submitted += (unsigned int)count;
+			for (size_t i = 0; i < count; i++)
+			{
+				const Bounds& bounds = archetype.WorldBounds[i];
+				float depth = glm::dot(bounds.Center - viewPos, viewDir);
+				commands.push_back({ &archetype.Meshes[i], archetype.Materials[i], &archetype.LocalToWorld[i], depth, culler.add(bounds) });
+			}
+		});
+
+		world.forEach(Component::Transform | Component::StaticMeshes, [&](const Archetype& archetype)
+		{
+			for (size_t i = 0; i < archetype.size(); i++)
+				submitStatic(world, archetype.StaticMeshes[i], archetype.LocalToWorld[i]);
+		});
+	}
+
+	// Culls, builds keys and sorts. Call once after the last submit, before drawing.
+	void prepare()
+	{
+		MaterialLibrary& library = MaterialLibrary::getInstance();
+
+		if (FrustumCulling)
+		{
+			culler.cull();
+			Stats.Culled += culler.Stats.Culled;
+		}
+
+		for (uint32_t i = 0; i < commands.size(); i++)
+		{
+			const RenderCommand& command = commands[i];
+			if (FrustumCulling && command.cullIndex != PreCulled)
+			{
+				if (!culler.isVisible(command.cullIndex))
+					continue;
+
+				if (Occlusion != nullptr && isOccluded(culler.getBounds(command.cullIndex)))
+				{
+					Stats.Culled++;
+					continue;
+				}
+			}
+
+			const Material& material = library.get(command.material);
+			entries.push_back({ makeKey(material, *command.vao, command.depth), i });
+		}
+
+		sortEntries();
+
+		// The pass sits in the top bits, so entries come out grouped by pass in draw order
+		opaqueEnd = findPassEnd(0, RenderPass::Opaque);
+		alphaTestedEnd = findPassEnd(opaqueEnd, RenderPass::AlphaTested);
+	}
+
+	// With DepthPrePass, depth is laid down first through the position-only VAOs and the lit pass
+	// then only shades the surviving fragments with GL_EQUAL
+	void drawOpaque()
+	{
+		if (!DepthPrePass)
+		{
+			drawRange(0, opaqueEnd);
+			return;
+		}
+
+		GLState& glState = GLState::getInstance();
+		drawDepthOnly(0, opaqueEnd);
+
+		glState.setDepthFunc(GL_EQUAL);
+		glState.setDepthMask(false);
+		drawRange(0, opaqueEnd);
+		glState.setDepthFunc(GL_LESS);
+		glState.setDepthMask(true);
+	}
+
+	// Kept out of the opaque pass and its pre-pass, discard would cost those early-z
+	void drawAlphaTested()
+	{
+		drawRange(opaqueEnd, alphaTestedEnd);
+	}
+
+	void drawTransparent()
+	{
+		if (alphaTestedEnd == entries.size())
+			return;
+
+		if (Transparency == TransparencyMode::WeightedBlended)
+		{
+			oit.begin();
+			drawRange(alphaTestedEnd, entries.size(), ShaderKeyword::WeightedOIT);
+			oit.end();
+			return;
+		}
+
+		GLState& glState = GLState::getInstance();
+		glState.setBlend(true);
+		glState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glState.setDepthMask(false);
+		drawRange(alphaTestedEnd, entries.size());
+		glState.setDepthMask(true);
+		glState.setBlend(false);
+	}
+
+	void flush()
+	{
+		prepare();
+		drawOpaque();
+		drawAlphaTested();
+		drawTransparent();
+	}
+
+	size_t size() const
+	{
+		return commands.size();
+	}
+
+private:
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t commandIndex;
+	};
+
+	glm::mat4 viewProjection;
+	glm::vec3 viewPos;
+	glm::vec3 viewDir;
+
+	std::vector<RenderCommand> commands;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+	FrustumCuller culler;
+	std::vector<uint32_t> visibleSubmeshes;
+	WeightedBlendedOIT oit;
+	size_t opaqueEnd;
+	size_t alphaTestedEnd;
+
+	// Leaves the primitives of bvh that pass the frustum, and the occlusion culler when one is
+	// attached, in visibleSubmeshes. model places the space the hierarchy was built in.
+	void queryBVH(const BVH& bvh, const glm::mat4& model)
+	{
+		visibleSubmeshes.clear();
+		glm::mat4 localToClip = viewProjection * model;
+		if (Occlusion != nullptr)
+		{
+			bvh.queryFrustum(Frustum::fromMatrix(localToClip), visibleSubmeshes,
+				[&](const glm::vec3& min, const glm::vec3& max) { return Occlusion->isOccluded(min, max, localToClip); });
+		}
+		else
+		{
+			bvh.queryFrustum(Frustum::fromMatrix(localToClip), visibleSubmeshes);
+		}
+	}
+
+	// Submeshes that left the set, destroyed or no longer BVHCulled, are skipped here
+	void submitStatic(const World& world, const StaticMeshSet& meshSet, const glm::mat4& rootToWorld)
+	{
+		if (FrustumCulling)
+		{
+			queryBVH(*meshSet.Hierarchy, rootToWorld);
+		}
+		else
+		{
+			visibleSubmeshes.resize(meshSet.Submeshes.size());
+			for (uint32_t i = 0; i < visibleSubmeshes.size(); i++)
+				visibleSubmeshes[i] = i;
+		}
+
+		unsigned int culled = (unsigned int)(meshSet.Submeshes.size() - visibleSubmeshes.size());
+		Stats.Submitted += culled;
+		Stats.Culled += culled;
+
+		for (uint32_t i : visibleSubmeshes)
+		{
+			Entity entity = meshSet.Submeshes[i];
+			if (!world.isAlive(entity) || (world.getMask(entity) & Component::BVHCulled) == 0)
+				continue;
+
+			EntityRef ref = world.get(entity);
+			const Archetype& archetype = *ref.Table;
+			float depth = glm::dot(archetype.WorldBounds[ref.Row].Center - viewPos, viewDir);
+			commands.push_back({ &archetype.Meshes[ref.Row], archetype.Materials[ref.Row], &archetype.LocalToWorld[ref.Row], depth, PreCulled });
+			Stats.Submitted++;
+		}
+	}
+
+	size_t findPassEnd(size_t first, RenderPass pass) const
+	{
+		size_t end = first;
+		while (end < entries.size() && (entries[end].key >> 62) == (uint64_t)pass)
+			end++;
+		return end;
+	}
+
+	// variantKeywords are added to each material's own, for passes that render to other targets
+	void drawRange(size_t first, size_t last, unsigned int variantKeywords = 0)
+	{
+		MaterialLibrary& library = MaterialLibrary::getInstance();
+		ShaderManager& shaderManager = ShaderManager::getInstance();
+		unsigned int lastProgram = 0;
+		unsigned int lastVAO = 0;
+		MaterialID lastMaterial = 0;
+		TextureSetID lastTextureSet = 0;
+		bool texturesBound = false;
+
+		for (size_t i = first; i < last; i++)
+		{
+			const RenderCommand& command = commands[entries[i].commandIndex];
+			const VertexArrayObject& vao = *command.vao;
+			const Material& material = library.get(command.material);
+			Shader variant = material.getShader();
+			if (variantKeywords != 0)
+			{
+				// The fallback program cannot write these targets, wait for the variant instead
+				variant = shaderManager.getVariant(variant.Keywords | variantKeywords);
+				if (!shaderManager.isReady(variant))
+					continue;
+			}
+
+			const Shader& shader = shaderManager.resolve(variant);
+
+			bool programChanged = shader.ID != lastProgram;
+			if (programChanged)
+			{
+				shader.use();
+				lastProgram = shader.ID;
+				texturesBound = false;
+				Stats.ProgramSwitches++;
+			}
+
+			if (vao.ID != lastVAO)
+			{
+				vao.bind();
+				lastVAO = vao.ID;
+				Stats.VAOSwitches++;
+			}
+
+			if (programChanged || material.ID != lastMaterial)
+			{
+				material.setMaterialUniforms(shader);
+				lastMaterial = material.ID;
+				Stats.MaterialUploads++;
+			}
+
+			if (!texturesBound || material.TextureSet != lastTextureSet)
+			{
+				material.bind();
+				lastTextureSet = material.TextureSet;
+				texturesBound = true;
+				Stats.TextureSwitches++;
+			}
+
+			setTransformUniforms(shader, *command.model);
+			vao.draw();
+			Stats.Draws++;
+		}
+	}
+
+	void drawDepthOnly(size_t first, size_t last)
+	{
+		GLState& glState = GLState::getInstance();
+		const Shader& shader = ShaderManager::getInstance().getDepthOnlyShader();
+		unsigned int lastVAO = 0;
+
+		shader.use();
+		glState.setColorMask(false);
+
+		for (size_t i = first; i < last; i++)
+		{
+			const RenderCommand& command = commands[entries[i].commandIndex];
+			const VertexArrayObject& vao = *command.vao;
+
+			if (vao.DepthOnlyID != lastVAO)
+			{
+				vao.bindDepthOnly();
+				lastVAO = vao.DepthOnlyID;
+			}
+
+			setTransformUniforms(shader, *command.model);
+			vao.draw();
+			Stats.DepthDraws++;
+		}
+
+		glState.setColorMask(true);
+	}
+
+	void setTransformUniforms(const Shader& shader, const glm::mat4& model) const
+	{
+		shader.setMat4(UniformLocation::Model, model);
+		shader.setMat4(UniformLocation::LocalToClip, viewProjection * model);
+	}
+
+	bool isOccluded(const Bounds& bounds) const
+	{
+		return Occlusion->isOccluded(bounds.Center - bounds.Extents, bounds.Center + bounds.Extents, viewProjection);
+	}
+
+	uint64_t makeKey(const Material& material, const VertexArrayObject& vao, float depth) const
+	{
+		uint64_t pass = (uint64_t)material.Pass;
+		uint64_t shader = material.getShader().ID & ((1u << ShaderBits) - 1);
+		uint64_t texture = material.Batched ? 0 : material.TextureSet & ((1u << TextureBits) - 1);
+		uint64_t materialID = material.ID & ((1u << MaterialBits) - 1);
+		uint64_t mesh = vao.ID & ((1u << MeshBits) - 1);
+		uint64_t quantizedDepth = quantizeDepth(depth);
+
+		uint64_t state = (shader << (TextureBits + MaterialBits + MeshBits))
+			| (texture << (MaterialBits + MeshBits))
+			| (materialID << MeshBits)
+			| mesh;
+
+		if (material.Pass == RenderPass::Transparent && Transparency == TransparencyMode::Sorted)
+		{
+			uint64_t invertedDepth = ((1ull << DepthBits) - 1) - quantizedDepth;
+			return (pass << 62) | (invertedDepth << (62 - DepthBits)) | state;
+		}
+
+		return (pass << 62) | (state << DepthBits) | quantizedDepth;
+	}
+
+	uint64_t quantizeDepth(float depth) const
+	{
+		float normalized = glm::clamp(depth / MaxDepth, 0.0f, 1.0f);
+		return (uint64_t)(normalized * (double)((1u << DepthBits) - 1));
+	}
+
+	// LSD radix sort, 8 bits per pass. Passes where every key shares the same byte are skipped,
+	// which is the common case for the high bytes since the pass and shader fields are sparse.
+	void sortEntries()
+	{
+		size_t count = entries.size();
+		if (count < 2)
+			return;
+
+		uint32_t histograms[8][256] = {};
+		for (const SortEntry& entry : entries)
+		{
+			for (int byte = 0; byte < 8; byte++)
+				histograms[byte][(entry.key >> (byte * 8)) & 0xFF]++;
+		}
+
+		scratch.resize(count);
+		SortEntry* src = entries.data();
+		SortEntry* dst = scratch.data();
+
+		for (int byte = 0; byte < 8; byte++)
+		{
+			uint32_t* histogram = histograms[byte];
+			if (histogram[(src[0].key >> (byte * 8)) & 0xFF] == count)
+				continue;
+
+			uint32_t offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++)
+			{
+				uint32_t bucketCount = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+
+			for (size_t i = 0; i < count; i++)
+				dst[histogram[(src[i].key >> (byte * 8)) & 0xFF]++] = src[i];
+
+			std::swap(src, dst);
+		}
+
+		if (src != entries.data())
+			entries.swap(scratch);
+	}
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+
+#include "glstate.h"
+
+// Copy of the default framebuffer's depth for passes that blend over the scene and need to read
+// it, such as soft particles. capture() once the opaque passes are done; the default framebuffer
+// must be D24S8 for the blit. The camera is kept with it, so work early in the next frame can
+// still project into last frame's depth.
+class SceneDepth
+{
+public:
+	static SceneDepth& getInstance()
+	{
+		static SceneDepth instance;
+		return instance;
+	}
+
+	// Sized after the current viewport
+	void capture(const glm::mat4& view, const glm::mat4& projection)
+	{
+		this->view = view;
+		this->projection = projection;
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		if (viewport[2] != width || viewport[3] != height)
+			createTarget(viewport[2], viewport[3]);
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// 0 until the first capture
+	unsigned int getTexture() const
+	{
+		return texture;
+	}
+
+	const glm::mat4& getView() const
+	{
+		return view;
+	}
+
+	const glm::mat4& getProjection() const
+	{
+		return projection;
+	}
+
+private:
+	unsigned int framebuffer;
+	unsigned int texture;
+	int width;
+	int height;
+	glm::mat4 view;
+	glm::mat4 projection;
+
+	SceneDepth()
+	{
+		framebuffer = texture = 0;
+		width = height = 0;
+		view = projection = glm::mat4(1.0f);
+	}
+
+	void createTarget(int width, int height)
+	{
+		if (framebuffer != 0)
+		{
+			glDeleteFramebuffers(1, &framebuffer);
+			GLState::getInstance().deleteTexture(texture);
+		}
+
+		this->width = width;
+		this->height = height;
+
+		glGenTextures(1, &texture);
+		GLState::getInstance().bindTexture(0, GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "Scene depth framebuffer is incomplete" << '\n';
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+public:
+	SceneDepth(SceneDepth const&) = delete;
+	void operator=(SceneDepth const&) = delete;
+};
@@ -4,78 +4,181 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "glstate.h"
+#include "shaderpreprocessor.h"
+#include "programbinarycache.h"
+#include "shaderpack.h"
+
 #include <iostream>
 #include <string>
 #include <fstream>
 #include <sstream>
 
+// Explicit uniform locations of the shaders, keep in sync with their layout (location = N)
+namespace UniformLocation
+{
+    // litShader.vert, depthOnly.vert
+    const int Model = 0;
+    const int LocalToClip = 1;
+    const int ViewProjection = 1; // INDIRECT_DRAW, replaces the two above
+
+    // material.glsl, lighting.glsl
+    const int MaterialIndex = 2;
+    const int ViewPos = 3;
+    const int DirLight = 4;      // direction, ambient, diffuse, specular
+    const int SpotLight = 8;     // position, ambient, diffuse, specular, direction, cutoff, outerCutoff, constant, linear, quadratic
+    const int PointLights = 18;  // position, ambient, diffuse, specular, constant, linear, quadratic per light
+    const int PointLightStride = 7;
+
+    // skyboxShader.vert
+    const int MVP = 0;
+
+    // particleBillboard.vert, particleBillboard.frag
+    const int View = 0;
+    const int Projection = 1;
+    const int InverseProjection = 2;
+    const int SoftDistance = 3;
+}
+
 class Shader
 {
 public:
     unsigned int ID;
+    unsigned int Keywords;
 
     Shader()
     {
         ID = -1;
+        Keywords = 0;
     }
 
-    Shader(const char* vertexPath, const char* fragmentPath)
+    // Compile work that is still in flight, see beginCompile
+    struct CompileJob
     {
+        unsigned int Vertex = 0;
+        unsigned int Fragment = 0;
+        uint64_t CacheKey = 0;
+
+        bool isPending() const
+        {
+            return Vertex != 0;
+        }
+    };
+
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "")
+    {
+        CompileJob job;
+        *this = beginCompile(vertexPath, fragmentPath, defines, job);
+        if (job.isPending())
+            finishCompile(job);
+    }
+
+    // Submits compilation and linking without querying any status, so drivers with threaded
+    // compilers can work on several programs at once. finishCompile must run once
+    // isLinkComplete returns true; the program must not be used before that.
+    static Shader beginCompile(const char* vertexPath, const char* fragmentPath, const std::string& defines, CompileJob& job)
+    {
+        Shader shader;
+
+        // Present sources always win, the pack is used for them only while its source hash matches
+        const ShaderPack& pack = ShaderPack::getInstance();
+        const ShaderPackEntry* packed = pack.find(vertexPath, fragmentPath, defines);
+
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
+        if (packed && !(ShaderPreprocessor::exists(vertexPath) && ShaderPreprocessor::exists(fragmentPath)))
         {
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream;
-            std::stringstream fShaderStream;
+            vertexCode = packed->VertexSource;
+            fragmentCode = packed->FragmentSource;
+        }
+        else
+        {
+            vertexCode = ShaderPreprocessor::process(vertexPath, defines);
+            fragmentCode = ShaderPreprocessor::process(fragmentPath, defines);
+            if (packed && !pack.matches(*packed, vertexCode, fragmentCode))
+                packed = nullptr;
+        }
 
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
+        ProgramBinaryCache& binaryCache = ProgramBinaryCache::getInstance();
+        job.CacheKey = binaryCache.makeKey(vertexCode, fragmentCode);
 
-            vShaderFile.close();
-            fShaderFile.close();
+        shader.ID = binaryCache.load(job.CacheKey);
+        if (shader.ID != 0)
+            return shader;
 
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+        if (packed && ShaderPack::useSpirv(*packed))
+        {
+            job.Vertex = ShaderPack::createSpirvShader(GL_VERTEX_SHADER, packed->VertexSpirv);
+            job.Fragment = ShaderPack::createSpirvShader(GL_FRAGMENT_SHADER, packed->FragmentSpirv);
         }
-        catch (std::ifstream::failure& e)
+        else
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-            std::cout << e.what() << std::endl;
+            const char* vShaderCode = vertexCode.c_str();
+            const char* fShaderCode = fragmentCode.c_str();
+
+            job.Vertex = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(job.Vertex, 1, &vShaderCode, NULL);
+            glCompileShader(job.Vertex);
+
+            job.Fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(job.Fragment, 1, &fShaderCode, NULL);
+            glCompileShader(job.Fragment);
         }
 
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
+        shader.ID = glCreateProgram();
+        glAttachShader(shader.ID, job.Vertex);
+        glAttachShader(shader.ID, job.Fragment);
+        binaryCache.prepare(shader.ID);
+        glLinkProgram(shader.ID);
+
+        return shader;
+    }
+
+    // Compute programs are few and needed right away, so they are built synchronously
+    static Shader compute(const char* computePath, const std::string& defines = "")
+    {
+        Shader shader;
+        std::string computeCode = ShaderPreprocessor::process(computePath, defines);
+        const char* cShaderCode = computeCode.c_str();
 
-        unsigned int vertex;
-        unsigned int fragment;
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        shader.checkCompileErrors(compute, "COMPUTE");
 
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        shader.ID = glCreateProgram();
+        glAttachShader(shader.ID, compute);
+        glLinkProgram(shader.ID);
+        shader.checkCompileErrors(shader.ID, "PROGRAM");
 
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        glDeleteShader(compute);
+        return shader;
+    }
 
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+    // Non-blocking with KHR_parallel_shader_compile. Without it there is nothing to poll and the
+    // first status query simply waits for the driver.
+    bool isLinkComplete() const
+    {
+        if (!GLEW_KHR_parallel_shader_compile)
+            return true;
 
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        int complete = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
     }
-    
+
+    void finishCompile(CompileJob& job)
+    {
+        checkCompileErrors(job.Vertex, "VERTEX");
+        checkCompileErrors(job.Fragment, "FRAGMENT");
+        if (checkCompileErrors(ID, "PROGRAM"))
+            ProgramBinaryCache::getInstance().store(job.CacheKey, ID);
+
+        glDeleteShader(job.Vertex);
+        glDeleteShader(job.Fragment);
+        job = CompileJob();
+    }
+
     int getAttributeLocation(const char* name) const
     {
         return glGetAttribLocation(ID, name);
@@ -83,57 +186,59 @@ public:
 
     void use() const
     {
-        glUseProgram(ID);
+        GLState::getInstance().useProgram(ID);
     }
 
-    void setBool(const char* name, bool value) const
+    // Uniforms are set through the layout (location = N) of the shaders, see UniformLocation,
+    // since programs created from SPIR-V keep no names to look up
+    void setBool(int location, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name), (int)value);
+        glUniform1i(location, (int)value);
     }
 
-    void setInt(const char* name, int value) const
+    void setInt(int location, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name), value);
+        glUniform1i(location, value);
     }
 
-    void setFloat(const char* name, float value) const
+    void setFloat(int location, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name), value);
+        glUniform1f(location, value);
     }
 
-    void setVec2(const char* name, const float value[2]) const
+    void setVec2(int location, const float value[2]) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name), 1, value);
+        glUniform2fv(location, 1, value);
     }
 
-    void setVec2(const char* name, float x, float y) const
+    void setVec2(int location, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name), x, y);
+        glUniform2f(location, x, y);
     }
 
-    void setVec3(const char* name, const float value[3]) const
+    void setVec3(int location, const float value[3]) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name), 1, value);
+        glUniform3fv(location, 1, value);
     }
 
-    void setVec3(const char* name, float x, float y, float z) const
+    void setVec3(int location, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name), x, y, z);
+        glUniform3f(location, x, y, z);
     }
 
-    void setVec3(const char* name, const glm::vec3& vec3) const
+    void setVec3(int location, const glm::vec3& vec3) const
     {
         float tempArr[3] = { vec3.x, vec3.y, vec3.z };
-        glUniform3fv(glGetUniformLocation(ID, name), 1, tempArr);
+        glUniform3fv(location, 1, tempArr);
     }
 
-    void setMat4(const char* name, const glm::mat4& value) const
+    void setMat4(int location, const glm::mat4& value) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(value));
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
     }
 
 private:
-    void checkCompileErrors(unsigned int shader, const std::string& type)
+    bool checkCompileErrors(unsigned int shader, const std::string& type)
     {
         int success;
         char infoLog[1024];
@@ -155,5 +260,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of Type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+
+        return success;
     }
 };
\ No newline at end of file
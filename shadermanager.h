@@ -4,11 +4,43 @@
 #include "pointlight.h"
 #include "spotlight.h"
 
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+
+// Permutation keywords of litShader.vert/.frag. Each set bit becomes a #define of the same name.
+namespace ShaderKeyword
+{
+	const unsigned int DiffuseMap = 1 << 0;
+	const unsigned int NormalMap = 1 << 1;
+	const unsigned int SpecularMap = 1 << 2;
+	const unsigned int Unlit = 1 << 3;
+	const unsigned int BatchedTextures = 1 << 4;
+	const unsigned int BindlessTextures = 1 << 5;
+	const unsigned int IndirectDraw = 1 << 6;
+	const unsigned int AlphaTest = 1 << 7;
+	const unsigned int WeightedOIT = 1 << 8;
+
+	const int Count = 9;
+	const char* const Names[Count] =
+	{
+		"DIFFUSE_MAP",
+		"NORMAL_MAP",
+		"SPECULAR_MAP",
+		"UNLIT",
+		"BATCHED_TEXTURES",
+		"BINDLESS_TEXTURES",
+		"INDIRECT_DRAW",
+		"ALPHA_TEST",
+		"WEIGHTED_OIT"
+	};
+}
 
 class ShaderManager
 {
 public:
+	static const int PointLightCount = 3;
+
 	static ShaderManager& getInstance()
 	{
 		static ShaderManager instance;
@@ -17,16 +49,100 @@ public:
 
 	Shader getShader(const std::string& name)
 	{
-		return shaderMap[name];
+		auto itr = shaderMap.find(name);
+		if (itr != shaderMap.end())
+			return itr->second;
+
+		auto alias = variantAliases.find(name);
+		if (alias != variantAliases.end())
+			return getVariant(alias->second);
+
+		std::cout << "Cannot find Shader: " << name << '\n';
+		return Shader();
+	}
+
+	// Submitted for compilation on first request and kept for the lifetime of the manager.
+	// The returned program may still be compiling, draw with resolve() until it is ready.
+	Shader getVariant(unsigned int keywords)
+	{
+		auto itr = variants.find(keywords);
+		if (itr != variants.end())
+			return itr->second;
+
+		Shader::CompileJob job;
+		Shader shader = Shader::beginCompile("litShader.vert", "litShader.frag", makeDefines(keywords), job);
+		shader.Keywords = keywords;
+		variants.insert(std::make_pair(keywords, shader));
+
+		if (job.isPending())
+		{
+			pending.push_back({ shader, job });
+			pendingIDs.insert(shader.ID);
+		}
+		else
+		{
+			onReady(shader);
+		}
+
+		return shader;
+	}
+
+	bool isReady(const Shader& shader) const
+	{
+		return pendingIDs.count(shader.ID) == 0;
+	}
+
+	// Stand-in for programs that are still compiling
+	const Shader& resolve(const Shader& shader) const
+	{
+		return isReady(shader) ? shader : fallback;
+	}
+
+	// Finishes every program whose link has completed, without waiting on the others.
+	// Call once per frame before the shared uniforms are updated.
+	void poll()
+	{
+		for (size_t i = 0; i < pending.size();)
+		{
+			PendingVariant& variant = pending[i];
+			if (!variant.shader.isLinkComplete())
+			{
+				i++;
+				continue;
+			}
+
+			variant.shader.finishCompile(variant.job);
+			onReady(variant.shader);
+			pending[i] = pending.back();
+			pending.pop_back();
+		}
+	}
+
+	// Position-only program for depth pre-passes, matches litShader.vert's gl_Position exactly
+	const Shader& getDepthOnlyShader() const
+	{
+		return depthOnly;
+	}
+
+	size_t getPendingCount() const
+	{
+		return pending.size();
 	}
 
-	void updateShadersCommon(float time, glm::vec3 viewPos)
+	void addShader(const std::string& name, const Shader& shader, bool isLighting)
+	{
+		shaderMap[name] = shader;
+
+		if (isLighting)
+			lightingShaders.push_back(shader);
+	}
+
+	void updateShadersCommon(glm::vec3 viewPos)
 	{
 		for (Shader& shader : lightingShaders)
 		{
 			shader.use();
-			shader.setFloat("u_time", time);
-			shader.setVec3("u_viewPos", viewPos);
+			shader.setVec3(UniformLocation::ViewPos, viewPos);
 		}
 	}
 
@@ -38,45 +154,89 @@ public:
 		{
 			shader.use();
 			dirLight.setOtherShaderUniforms(shader);
-			for (int i = 0; i < pointLights.size(); i++)
+			for (int i = 0; i < pointLights.size() && i < PointLightCount; i++)
 				pointLights[i].setOtherShaderUniforms(shader, i);
 			spotLight.setOtherShaderUniforms(shader);
 		}
 	}
 
 private:
+	struct PendingVariant
+	{
+		Shader shader;
+		Shader::CompileJob job;
+	};
+
 	ShaderManager()
 	{
-		Shader textured = Shader("texturedShader.vert", "texturedShader.frag");
-		Shader untextured = Shader("untexturedShader.vert", "untexturedShader.frag");
-		Shader unlitShader = Shader("texturedShader.vert", "unlitShader.frag");
-		Shader skyboxShader = Shader("skyboxShader.vert", "skyboxShader.frag");
+		if (GLEW_KHR_parallel_shader_compile)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
 
-		lightingShaders.push_back(textured);
-		lightingShaders.push_back(untextured);
+		// The stand-in has to be usable right away
+		Shader::CompileJob job;
+		fallback = Shader::beginCompile("litShader.vert", "litShader.frag", makeDefines(0), job);
+		if (job.isPending())
+			fallback.finishCompile(job);
+		variants.insert(std::make_pair(0u, fallback));
+		onReady(fallback);
+
+		depthOnly = Shader("depthOnly.vert", "depthOnly.frag");
+		Shader skyboxShader = Shader("skyboxShader.vert", "skyboxShader.frag");
 
 		shaderMap.insert(std::make_pair(
+			"SkyboxShader",
+			skyboxShader
+		));
+
+		variantAliases.insert(std::make_pair(
 			"TexturedShader",
-			textured
+			ShaderKeyword::DiffuseMap | ShaderKeyword::NormalMap | ShaderKeyword::SpecularMap
 		));
-		shaderMap.insert(std::make_pair(
+		variantAliases.insert(std::make_pair(
 			"UntexturedShader",
-			untextured
+			0u
 		));
-		shaderMap.insert(std::make_pair(
+		variantAliases.insert(std::make_pair(
 			"UnlitShader",
-			unlitShader
-		));
-		shaderMap.insert(std::make_pair(
-			"SkyboxShader",
-			skyboxShader
+			ShaderKeyword::Unlit
 		));
+
+		// Submit the common variants up front so they compile while assets load
+		for (const auto& alias : variantAliases)
+			getVariant(alias.second);
+	}
+
+	void onReady(const Shader& shader)
+	{
+		pendingIDs.erase(shader.ID);
+
+		if ((shader.Keywords & ShaderKeyword::Unlit) == 0)
+			lightingShaders.push_back(shader);
+	}
+
+	std::string makeDefines(unsigned int keywords) const
+	{
+		std::string defines = "#define NR_POINT_LIGHTS " + std::to_string(PointLightCount) + "\n";
+
+		for (int i = 0; i < ShaderKeyword::Count; i++)
+		{
+			if (keywords & (1u << i))
+				defines += std::string("#define ") + ShaderKeyword::Names[i] + "\n";
+		}
+
+		return defines;
 	}
 
 	std::unordered_map<std::string, Shader> shaderMap;
+	std::unordered_map<std::string, unsigned int> variantAliases;
+	std::unordered_map<unsigned int, Shader> variants;
+	std::vector<PendingVariant> pending;
+	std::unordered_set<unsigned int> pendingIDs;
 	std::vector<Shader> lightingShaders;
+	Shader fallback;
+	Shader depthOnly;
 
 public:
 	ShaderManager(ShaderManager const&) = delete;
 	void operator=(ShaderManager const&) = delete;
-};
\ No newline at end of file
+};
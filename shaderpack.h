@@ -0,0 +1,170 @@
+#pragma once
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Programs precompiled offline by tools/build_shaderpack.py. Every entry holds the preprocessed
+// GLSL of one program and, when the permutation allows it, validated and optimized SPIR-V.
+struct ShaderPackEntry
+{
+	uint64_t SourceHash;
+	std::string VertexSource;
+	std::string FragmentSource;
+	std::vector<char> VertexSpirv;
+	std::vector<char> FragmentSpirv;
+
+	bool hasSpirv() const
+	{
+		return !VertexSpirv.empty() && !FragmentSpirv.empty();
+	}
+};
+
+// File layout, little endian:
+//   "SPK3", uint32 entry count, then per entry
+//   uint64 key, uint64 source hash, and four uint32 size-prefixed blobs: vertex GLSL, fragment GLSL,
+//   vertex SPIR-V, fragment SPIR-V
+// The key is FNV-1a over "vertexPath|fragmentPath|defines", with defines exactly as ShaderManager builds them.
+// The source hash is FNV-1a over the preprocessed vertex GLSL, a '|' and the preprocessed fragment GLSL.
+// Where the shader sources are present they are still expanded, which is cheap next to compiling,
+// and an entry whose source hash no longer matches them is ignored, so a pack left over from
+// older sources never shadows edits. Without the sources the pack stands in for them.
+class ShaderPack
+{
+public:
+	static constexpr const char* DefaultPath = "shaders.pack";
+
+	static ShaderPack& getInstance()
+	{
+		static ShaderPack instance;
+		return instance;
+	}
+
+	const ShaderPackEntry* find(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines) const
+	{
+		auto itr = entries.find(makeKey(vertexPath, fragmentPath, defines));
+		if (itr == entries.end())
+			return nullptr;
+
+		return &itr->second;
+	}
+
+	// Reports the first mismatch only, a stale pack usually differs in every program
+	bool matches(const ShaderPackEntry& entry, const std::string& vertexSource, const std::string& fragmentSource) const
+	{
+		if (entry.SourceHash == hashSources(vertexSource, fragmentSource))
+			return true;
+
+		if (!reportedStale)
+		{
+			std::cout << "Shader pack is older than the shader sources, compiling from source" << std::endl;
+			reportedStale = true;
+		}
+		return false;
+	}
+
+	// The bindless extension has no SPIR-V mapping, so those permutations come without it
+	static bool useSpirv(const ShaderPackEntry& entry)
+	{
+		return entry.hasSpirv() && GLEW_ARB_gl_spirv;
+	}
+
+	static uint64_t makeKey(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+	{
+		return fnv1a(vertexPath + '|' + fragmentPath + '|' + defines);
+	}
+
+	static uint64_t hashSources(const std::string& vertexSource, const std::string& fragmentSource)
+	{
+		return fnv1a(vertexSource + '|' + fragmentSource);
+	}
+
+	// Skips the GLSL front end, glSpecializeShaderARB errors are reported through the usual compile status
+	static unsigned int createSpirvShader(GLenum type, const std::vector<char>& spirv)
+	{
+		unsigned int shader = glCreateShader(type);
+		glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, spirv.data(), (GLsizei)spirv.size());
+		glSpecializeShaderARB(shader, "main", 0, NULL, NULL);
+		return shader;
+	}
+
+private:
+	std::unordered_map<uint64_t, ShaderPackEntry> entries;
+	mutable bool reportedStale;
+
+	static uint64_t fnv1a(const std::string& text)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned char c : text)
+		{
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	ShaderPack()
+	{
+		reportedStale = false;
+		load(DefaultPath);
+	}
+
+	void load(const char* path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+			return;
+
+		char magic[4];
+		uint32_t count = 0;
+		file.read(magic, 4);
+		file.read(reinterpret_cast<char*>(&count), sizeof(count));
+		if (!file || std::string(magic, 4) != "SPK3")
+		{
+			std::cout << "Ignoring invalid shader pack: " << path << '\n';
+			return;
+		}
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint64_t key = 0;
+			ShaderPackEntry entry;
+			std::vector<char> vertexSource;
+			std::vector<char> fragmentSource;
+
+			file.read(reinterpret_cast<char*>(&key), sizeof(key));
+			file.read(reinterpret_cast<char*>(&entry.SourceHash), sizeof(entry.SourceHash));
+			if (!readBlob(file, vertexSource) || !readBlob(file, fragmentSource)
+				|| !readBlob(file, entry.VertexSpirv) || !readBlob(file, entry.FragmentSpirv))
+			{
+				std::cout << "Truncated shader pack: " << path << '\n';
+				entries.clear();
+				return;
+			}
+
+			entry.VertexSource.assign(vertexSource.begin(), vertexSource.end());
+			entry.FragmentSource.assign(fragmentSource.begin(), fragmentSource.end());
+			entries.insert(std::make_pair(key, std::move(entry)));
+		}
+
+		std::cout << "Loaded shader pack " << path << " with programs: " << entries.size() << std::endl;
+	}
+
+	static bool readBlob(std::ifstream& file, std::vector<char>& blob)
+	{
+		uint32_t size = 0;
+		if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)))
+			return false;
+
+		blob.resize(size);
+		return size == 0 || (bool)file.read(blob.data(), size);
+	}
+
+public:
+	ShaderPack(ShaderPack const&) = delete;
+	void operator=(ShaderPack const&) = delete;
+};
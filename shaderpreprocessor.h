@@ -0,0 +1,85 @@
+#pragma once
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+
+// Resolves #include "file" (relative to the including file, each file at most once) and
+// injects permutation defines right after the #version line.
+class ShaderPreprocessor
+{
+public:
+	static std::string process(const std::string& path, const std::string& defines = "")
+	{
+		std::unordered_set<std::string> included;
+		std::string source = expand(path, included);
+		injectDefines(source, defines);
+		return source;
+	}
+
+	static bool exists(const std::string& path)
+	{
+		return std::ifstream(path).is_open();
+	}
+
+private:
+	static std::string expand(const std::string& path, std::unordered_set<std::string>& included)
+	{
+		if (!included.insert(path).second)
+			return "";
+
+		std::ifstream file(path);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+			return "";
+		}
+
+		std::string directory;
+		size_t slash = path.find_last_of("/\\");
+		if (slash != std::string::npos)
+			directory = path.substr(0, slash + 1);
+
+		std::stringstream output;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::string includePath;
+			if (parseInclude(line, includePath))
+				output << expand(directory + includePath, included);
+			else
+				output << line << '\n';
+		}
+
+		return output.str();
+	}
+
+	static bool parseInclude(const std::string& line, std::string& includePath)
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+			return false;
+
+		size_t open = line.find('"', start + 8);
+		size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+		if (close == std::string::npos)
+			return false;
+
+		includePath = line.substr(open + 1, close - open - 1);
+		return true;
+	}
+
+	// Defines have to follow the #version line, which must stay first in the source
+	static void injectDefines(std::string& code, const std::string& defines)
+	{
+		if (defines.empty())
+			return;
+
+		size_t versionEnd = code.find('\n', code.find("#version"));
+		if (versionEnd == std::string::npos)
+			code = defines + code;
+		else
+			code.insert(versionEnd + 1, defines);
+	}
+};
@@ -1,9 +1,9 @@
 #version 430
-in vec3 TexCoords;
+layout (location = 0) in vec3 TexCoords;
 
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
 
-uniform samplerCube skybox;
+layout (binding = 0) uniform samplerCube skybox;
 
 void main()
 {    
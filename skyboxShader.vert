@@ -1,12 +1,13 @@
 #version 430
 layout (location = 0) in vec3 v_position;
 
-out vec3 TexCoords;
+layout (location = 0) out vec3 TexCoords;
 
-uniform mat4 u_MVP;
+layout (location = 0) uniform mat4 u_MVP;
 
 void main()
 {
     TexCoords = v_position;
-    gl_Position = u_MVP * vec4(v_position, 1.0);
+    // z = w puts the box on the far plane, drawn last it only shades pixels nothing else covered
+    gl_Position = (u_MVP * vec4(v_position, 1.0)).xyww;
 }  
\ No newline at end of file
@@ -38,15 +38,15 @@ public:
 
 	void setOtherShaderUniforms(Shader shader) const
 	{
-		shader.setVec3("u_spotLight.position", Position);
-		shader.setVec3("u_spotLight.direction", Direction);
-		shader.setFloat("u_spotLight.cutoff", glm::cos(glm::radians(cutoff)));
-		shader.setFloat("u_spotLight.outerCutoff", glm::cos(glm::radians(outerCutoff)));
-		shader.setVec3("u_spotLight.ambient", Ambient);
-		shader.setVec3("u_spotLight.diffuse", Diffuse);
-		shader.setVec3("u_spotLight.specular", Specular);
-		shader.setFloat("u_spotLight.constant", 1.0f);
-		shader.setFloat("u_spotLight.linear", 0.15f);
-		shader.setFloat("u_spotLight.quadratic", 0.1f);
+		shader.setVec3(UniformLocation::SpotLight + 0, Position);
+		shader.setVec3(UniformLocation::SpotLight + 4, Direction);
+		shader.setFloat(UniformLocation::SpotLight + 5, glm::cos(glm::radians(cutoff)));
+		shader.setFloat(UniformLocation::SpotLight + 6, glm::cos(glm::radians(outerCutoff)));
+		shader.setVec3(UniformLocation::SpotLight + 1, Ambient);
+		shader.setVec3(UniformLocation::SpotLight + 2, Diffuse);
+		shader.setVec3(UniformLocation::SpotLight + 3, Specular);
+		shader.setFloat(UniformLocation::SpotLight + 7, 1.0f);
+		shader.setFloat(UniformLocation::SpotLight + 8, 0.15f);
+		shader.setFloat(UniformLocation::SpotLight + 9, 0.1f);
 	}
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "image.h"
+#include "glstate.h"
 
 #include <algorithm>
 
@@ -10,18 +11,32 @@ enum class TextureType
 	Specular
 };
 
+// How a texture uses its alpha channel, decides the render pass of materials using it as diffuse map
+enum class AlphaUsage
+{
+	None = 0,
+	Cutout,
+	Translucent
+};
+
 class Texture
 {
 public:
-	static const char* ShaderUniforms[];
-
 	unsigned int ID;
 	TextureType textureType;
+	int Width;
+	int Height;
+	int Format;
+	AlphaUsage Alpha;
 
 	Texture()
 	{
 		ID = 4096;
 		textureType = TextureType();
+		Width = 0;
+		Height = 0;
+		Format = 0;
+		Alpha = AlphaUsage::None;
 	}
 
 	Texture(const std::string& filePath)
@@ -29,9 +44,13 @@ public:
 		Image img(filePath);
 
 		textureType = getTextureType(filePath);
+		Width = img.width;
+		Height = img.height;
+		Format = img.format;
+		Alpha = classifyAlpha(img);
 
 		glGenTextures(1, &ID);
-		glBindTexture(GL_TEXTURE_2D, ID);
+		GLState::getInstance().bindTexture(0, GL_TEXTURE_2D, ID);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -50,16 +69,41 @@ public:
 		glGenerateMipmap(GL_TEXTURE_2D);
 	}
 
-	void bindTexture(unsigned int shaderID, int textureTypeID) const
+	// Sampler units are fixed with layout(binding) in material.glsl
+	void bindTexture(int unit) const
 	{
-		std::string textureName(ShaderUniforms[(int)textureType]);
-		GLint textureLoc = glGetUniformLocation(shaderID, textureName.c_str());
-		glUniform1i(textureLoc, textureTypeID);
-		glActiveTexture(GL_TEXTURE0 + textureTypeID);
-		glBindTexture(GL_TEXTURE_2D, ID);
+		GLState::getInstance().bindTexture(unit, GL_TEXTURE_2D, ID);
 	}
 
 private:
+	// Alpha that is almost always fully on or off is a cutout. The few soft texels that
+	// filtering or anti-aliasing leave along the edges do not make a texture translucent, only
+	// more than MaxSoftTexels of the image does. Soft edges alone leave an opaque texture opaque.
+	static AlphaUsage classifyAlpha(const Image& img)
+	{
+		const float MaxSoftTexels = 0.05f;
+
+		if (img.channelCount != 4 || img.data == nullptr)
+			return AlphaUsage::None;
+
+		size_t pixelCount = (size_t)img.width * img.height;
+		size_t cutCount = 0;
+		size_t partialCount = 0;
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			unsigned char alpha = img.data[i * 4 + 3];
+			if (alpha <= 8)
+				cutCount++;
+			else if (alpha < 247)
+				partialCount++;
+		}
+
+		if ((float)partialCount > MaxSoftTexels * pixelCount)
+			return AlphaUsage::Translucent;
+
+		return cutCount > 0 ? AlphaUsage::Cutout : AlphaUsage::None;
+	}
+
 	TextureType getTextureType(std::string path)
 	{
 		std::transform(path.begin(), path.end(), path.begin(), std::tolower);
@@ -73,9 +117,3 @@ private:
 	}
 };
 
-const char* Texture::ShaderUniforms[] =
-{
-	"u_material.diffuseMap",
-	"u_material.normalMap",
-	"u_material.specularMap"
-};
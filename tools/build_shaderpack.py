@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+"""Offline shader validation and SPIR-V precompilation.
+
+Expands every program and permutation the runtime can request, validates it with
+glslangValidator, compiles it to OpenGL SPIR-V, optimizes it with spirv-opt and writes
+the result, with the preprocessed GLSL and its hash, to a shader pack that ShaderPack
+(shaderpack.h) loads at startup. Building the Visual Studio project with
+/p:BuildShaderPack=true runs this after the build.
+
+Only the Khronos command line tools are needed, no GPU or GL context, so this runs on CI:
+
+    python tools/build_shaderpack.py                 # writes shaders.pack
+    python tools/build_shaderpack.py --validate-only # CI check, writes nothing
+
+Keep PROGRAMS, KEYWORDS and make_defines() in sync with ShaderManager.
+"""
+
+import argparse
+import itertools
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# ShaderKeyword bit order
+KEYWORDS = [
+    "DIFFUSE_MAP",
+    "NORMAL_MAP",
+    "SPECULAR_MAP",
+    "UNLIT",
+    "BATCHED_TEXTURES",
+    "BINDLESS_TEXTURES",
+    "INDIRECT_DRAW",
+    "ALPHA_TEST",
+    "WEIGHTED_OIT",
+]
+(DIFFUSE_MAP, NORMAL_MAP, SPECULAR_MAP, UNLIT, BATCHED_TEXTURES, BINDLESS_TEXTURES, INDIRECT_DRAW,
+ ALPHA_TEST, WEIGHTED_OIT) = (1 << i for i in range(len(KEYWORDS)))
+
+# ShaderManager::PointLightCount
+POINT_LIGHT_COUNT = 3
+
+
+def make_defines(keywords):
+    defines = "#define NR_POINT_LIGHTS %d\n" % POINT_LIGHT_COUNT
+    for i, name in enumerate(KEYWORDS):
+        if keywords & (1 << i):
+            defines += "#define %s\n" % name
+    return defines
+
+
+def lit_permutations():
+    """Keyword sets the importer and MaterialTable can produce."""
+    yield UNLIT
+    for diffuse, normal, specular in itertools.product((0, DIFFUSE_MAP), (0, NORMAL_MAP), (0, SPECULAR_MAP)):
+        if normal and not diffuse:
+            continue
+        base = diffuse | normal | specular
+        yield base
+        # Transparent materials, alpha tested ones need a diffuse map to test against
+        yield base | WEIGHTED_OIT
+        if not base:
+            yield INDIRECT_DRAW
+        if diffuse:
+            yield base | ALPHA_TEST
+            for batched in (BATCHED_TEXTURES, BATCHED_TEXTURES | BINDLESS_TEXTURES):
+                yield base | batched
+                yield base | batched | ALPHA_TEST
+                yield base | batched | WEIGHTED_OIT
+                # GPUCuller only takes opaque materials that need no per-draw texture binds
+                yield base | batched | INDIRECT_DRAW
+
+
+# Built at runtime with Shader::compute, validated here but not packed
+COMPUTE_SHADERS = [
+    ("gpuCulling.comp", ""),
+    ("depthPyramid.comp", ""),
+    # GPUParticleSystem builds one program per pass
+    ("gpuParticles.comp", "#define PARTICLE_KICK\n"),
+    ("gpuParticles.comp", "#define PARTICLE_EMIT\n"),
+    ("gpuParticles.comp", "#define PARTICLE_SIMULATE\n"),
+]
+
+
+def programs():
+    yield "skyboxShader.vert", "skyboxShader.frag", ""
+    yield "depthOnly.vert", "depthOnly.frag", ""
+    yield "oitComposite.vert", "oitComposite.frag", ""
+    yield "particleBillboard.vert", "particleBillboard.frag", ""
+    yield "particleBillboard.vert", "particleBillboard.frag", "#define GPU_PARTICLES\n"
+    for keywords in lit_permutations():
+        yield "litShader.vert", "litShader.frag", make_defines(keywords)
+
+
+def preprocess(path, defines):
+    """Same rules as ShaderPreprocessor: quoted includes relative to the includer, each file once."""
+    included = set()
+
+    def expand(file_path):
+        if file_path in included:
+            return ""
+        included.add(file_path)
+
+        directory = os.path.dirname(file_path)
+        output = []
+        with open(os.path.join(ROOT, file_path), encoding="utf-8") as source:
+            for line in source.read().splitlines():
+                stripped = line.lstrip()
+                if stripped.startswith("#include"):
+                    parts = stripped.split('"')
+                    if len(parts) >= 3:
+                        output.append(expand(os.path.join(directory, parts[1]).replace("\\", "/")))
+                        continue
+                output.append(line + "\n")
+        return "".join(output)
+
+    code = expand(path)
+    if defines:
+        version = code.find("#version")
+        line_end = code.find("\n", version)
+        code = defines + code if line_end < 0 else code[:line_end + 1] + defines + code[line_end + 1:]
+    return code
+
+
+def fnv1a(text):
+    value = 14695981039346656037
+    for byte in text.encode("utf-8"):
+        value ^= byte
+        value = (value * 1099511628211) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+
+class Toolchain:
+    def __init__(self, glslang, spirv_opt, optimize):
+        self.glslang = shutil.which(glslang) or glslang
+        self.spirv_opt = shutil.which(spirv_opt) or spirv_opt
+        self.optimize = optimize
+
+    def run(self, args):
+        result = subprocess.run(args, capture_output=True, text=True)
+        return result.returncode == 0, (result.stdout + result.stderr).strip()
+
+    def validate_glsl(self, stage_files):
+        return self.run([self.glslang, "-l"] + stage_files)
+
+    def compile_spirv(self, stage_file, output):
+        ok, log = self.run([self.glslang, "-G", "-o", output, stage_file])
+        if not ok or not self.optimize:
+            return ok, log
+        return self.run([self.spirv_opt, "-O", "--target-env=opengl4.5", output, "-o", output])
+
+
+def build(toolchain, validate_only, output_path):
+    entries = []
+    failures = 0
+
+    with tempfile.TemporaryDirectory() as work:
+        for index, (compute_path, defines) in enumerate(COMPUTE_SHADERS):
+            stage_file = os.path.join(work, "%d_%s" % (index, os.path.basename(compute_path)))
+            with open(stage_file, "w", encoding="utf-8") as compute_file:
+                compute_file.write(preprocess(compute_path, defines))
+
+            ok, log = toolchain.validate_glsl([stage_file])
+            print("%s %s %s" % ("ok    " if ok else "FAILED", compute_path, " ".join(defines.split()[1::2])))
+            if not ok:
+                print(log)
+                failures += 1
+
+        for index, (vertex_path, fragment_path, defines) in enumerate(programs()):
+            keywords = [line.split()[1] for line in defines.splitlines() if len(line.split()) == 2]
+            label = "%s + %s [%s]" % (vertex_path, fragment_path, " ".join(keywords) or "-")
+            sources = {
+                "vert": preprocess(vertex_path, defines),
+                "frag": preprocess(fragment_path, defines),
+            }
+
+            stage_files = {}
+            for stage, code in sources.items():
+                stage_files[stage] = os.path.join(work, "%d.%s" % (index, stage))
+                with open(stage_files[stage], "w", encoding="utf-8") as stage_file:
+                    stage_file.write(code)
+
+            ok, log = toolchain.validate_glsl([stage_files["vert"], stage_files["frag"]])
+            if not ok:
+                print("FAILED %s\n%s" % (label, log))
+                failures += 1
+                continue
+
+            # The bindless extension has no OpenGL SPIR-V mapping, those stay GLSL only
+            spirv = {"vert": b"", "frag": b""}
+            if "BINDLESS_TEXTURES" not in defines:
+                for stage in ("vert", "frag"):
+                    spv_path = stage_files[stage] + ".spv"
+                    ok, log = toolchain.compile_spirv(stage_files[stage], spv_path)
+                    if not ok:
+                        break
+                    with open(spv_path, "rb") as spv_file:
+                        spirv[stage] = spv_file.read()
+                if not ok:
+                    print("FAILED %s (SPIR-V)\n%s" % (label, log))
+                    failures += 1
+                    continue
+
+            print("ok     %s" % label)
+            key = fnv1a("%s|%s|%s" % (vertex_path, fragment_path, defines))
+            # ShaderPack rejects the entry once the sources it was built from change
+            source_hash = fnv1a("%s|%s" % (sources["vert"], sources["frag"]))
+            entries.append((key, source_hash, sources["vert"], sources["frag"], spirv["vert"], spirv["frag"]))
+
+    if failures:
+        print("%d program(s) failed validation" % failures)
+        return 1
+
+    if validate_only:
+        return 0
+
+    with open(output_path, "wb") as pack:
+        pack.write(b"SPK3")
+        pack.write(struct.pack("<I", len(entries)))
+        for key, source_hash, vertex, fragment, vertex_spirv, fragment_spirv in entries:
+            pack.write(struct.pack("<QQ", key, source_hash))
+            for blob in (vertex.encode("utf-8"), fragment.encode("utf-8"), vertex_spirv, fragment_spirv):
+                pack.write(struct.pack("<I", len(blob)))
+                pack.write(blob)
+
+    print("Wrote %s with %d programs" % (output_path, len(entries)))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--output", default=os.path.join(ROOT, "shaders.pack"))
+    parser.add_argument("--validate-only", action="store_true", help="validate and compile, but do not write the pack")
+    parser.add_argument("--no-optimize", action="store_true", help="skip spirv-opt")
+    parser.add_argument("--glslang", default="glslangValidator")
+    parser.add_argument("--spirv-opt", default="spirv-opt")
+    args = parser.parse_args()
+
+    toolchain = Toolchain(args.glslang, args.spirv_opt, not args.no_optimize)
+    return build(toolchain, args.validate_only, args.output)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -2,6 +2,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <cmath>
+
 class Transformable
 {
 public:
@@ -20,12 +22,27 @@ public:
 
 	void updateModelMatrix()
 	{
-		Model = glm::mat4(1.0f);
-		Model = glm::translate(Model, glm::vec3(Position.x, Position.y, Position.z));
-		Model = glm::rotate(Model, Rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
-		Model = glm::rotate(Model, Rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
-		Model = glm::rotate(Model, Rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-		Model = glm::scale(Model, glm::vec3(Scale.x, Scale.y, Scale.z));
+		Model = compose(Position, Rotation, Scale);
+	}
+
+	// Translation, then rotation about z, x and y, then scale, with the rotations built directly
+	// instead of through a chain of 4x4 products
+	static glm::mat4 compose(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale)
+	{
+		float sx = std::sin(rotation.x), cx = std::cos(rotation.x);
+		float sy = std::sin(rotation.y), cy = std::cos(rotation.y);
+		float sz = std::sin(rotation.z), cz = std::cos(rotation.z);
+
+		glm::mat3 rotateZ(cz, sz, 0.0f, -sz, cz, 0.0f, 0.0f, 0.0f, 1.0f);
+		glm::mat3 rotateX(1.0f, 0.0f, 0.0f, 0.0f, cx, sx, 0.0f, -sx, cx);
+		glm::mat3 rotateY(cy, 0.0f, -sy, 0.0f, 1.0f, 0.0f, sy, 0.0f, cy);
+		glm::mat3 basis = rotateZ * rotateX * rotateY;
+
+		return glm::mat4(
+			glm::vec4(basis[0] * scale.x, 0.0f),
+			glm::vec4(basis[1] * scale.y, 0.0f),
+			glm::vec4(basis[2] * scale.z, 0.0f),
+			glm::vec4(position, 1.0f));
 	}
 
 	glm::mat4 getMVP(const glm::mat4& viewProjection) const
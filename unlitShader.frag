@@ -1,7 +0,0 @@
-#version 430
-out vec4 FragColor;
-
-void main()
-{
-    FragColor = vec4(1.0);
-}
\ No newline at end of file
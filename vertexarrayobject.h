@@ -2,20 +2,26 @@
 #include <GL/glew.h>
 #include <glfw/glfw3.h>
 
+#include "glstate.h"
+#include "bounds.h"
+
 class VertexArrayObject
 {
 public:
 	unsigned int ID;
+	unsigned int DepthOnlyID; // Positions and indices only, for depth passes
 	unsigned int VertexPositionID;
 	unsigned int VertexNormalsID;
 	unsigned int VertexTexCoordsID;
 	unsigned int VertexTangentsID;
 	unsigned int IndicesID;
 	size_t IndicesSize;
+	Bounds LocalBounds;
 
 	VertexArrayObject()
 	{
 		ID = 4096;
+		DepthOnlyID = 4096;
 		VertexPositionID = 4096;
 		VertexNormalsID = 4096;
 		VertexTexCoordsID = 4096;
@@ -30,8 +36,10 @@ public:
 		const std::vector<unsigned int>& indices)
 		: VertexArrayObject()
 	{
+		LocalBounds = Bounds::fromPositions(pos);
+
 		glGenVertexArrays(1, &ID);
-		glBindVertexArray(ID);
+		GLState::getInstance().bindVertexArray(ID);
 
 		generateBufferLayout(VertexPositionID, pos, 0, 3);
 		generateBufferLayout(VertexNormalsID, norm, 1, 3);
@@ -105,11 +113,27 @@ public:
 		glGenBuffers(1, &IndicesID);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndicesID);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndicesSize * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+		// Shares the buffers, but only fetches positions
+		glGenVertexArrays(1, &DepthOnlyID);
+		GLState::getInstance().bindVertexArray(DepthOnlyID);
+		if (VertexPositionID != 4096)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, VertexPositionID);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+			glEnableVertexAttribArray(0);
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndicesID);
 	}
 
 	void bind() const
 	{
-		glBindVertexArray(ID);
+		GLState::getInstance().bindVertexArray(ID);
+	}
+
+	void bindDepthOnly() const
+	{
+		GLState::getInstance().bindVertexArray(DepthOnlyID);
 	}
 
 	void draw() const
@@ -0,0 +1,126 @@
+#pragma once
+#include <GL/glew.h>
+
+#include <iostream>
+
+#include "glstate.h"
+#include "shader.h"
+
+// Order independent transparency after McGuire and Bavoil 2013. Transparent surfaces add their
+// premultiplied color, weighted by depth and coverage, to an RGBA16F target and multiply their
+// (1 - alpha) into an R8 revealage target; end() resolves both over the default framebuffer.
+// No sorting is needed, at the cost of an approximate result where layers of very different
+// opacity overlap. The opaque depth is blitted over, so the default framebuffer must be D24S8.
+class WeightedBlendedOIT
+{
+public:
+	WeightedBlendedOIT()
+	{
+		framebuffer = accumulationTexture = revealageTexture = depthTexture = emptyVAO = 0;
+		width = height = 0;
+	}
+
+	// Targets follow the current viewport. Draw with the WEIGHTED_OIT variants until end().
+	void begin()
+	{
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		if (viewport[2] != width || viewport[3] != height)
+			createTargets(viewport[2], viewport[3]);
+
+		if (compositeShader.ID == (unsigned int)-1)
+		{
+			compositeShader = Shader("oitComposite.vert", "oitComposite.frag");
+			glGenVertexArrays(1, &emptyVAO);
+		}
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+		const float accumulationClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		const float revealageClear[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+		glClearBufferfv(GL_COLOR, 0, accumulationClear);
+		glClearBufferfv(GL_COLOR, 1, revealageClear);
+
+		GLState& glState = GLState::getInstance();
+		glState.setDepthMask(false);
+		glState.setBlend(true);
+		glState.setBlendFunci(0, GL_ONE, GL_ONE);
+		glState.setBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+	}
+
+	void end()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		GLState& glState = GLState::getInstance();
+		glState.setDepthTest(false);
+		glState.setBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+
+		compositeShader.use();
+		glState.bindTexture(0, GL_TEXTURE_2D, accumulationTexture);
+		glState.bindTexture(1, GL_TEXTURE_2D, revealageTexture);
+		glState.bindVertexArray(emptyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		glState.setDepthTest(true);
+		glState.setBlend(false);
+		glState.setDepthMask(true);
+	}
+
+private:
+	Shader compositeShader;
+	unsigned int framebuffer;
+	unsigned int accumulationTexture;
+	unsigned int revealageTexture;
+	unsigned int depthTexture;
+	unsigned int emptyVAO;
+	int width;
+	int height;
+
+	void createTargets(int width, int height)
+	{
+		if (framebuffer != 0)
+		{
+			GLState& glState = GLState::getInstance();
+			glDeleteFramebuffers(1, &framebuffer);
+			glState.deleteTexture(accumulationTexture);
+			glState.deleteTexture(revealageTexture);
+			glState.deleteTexture(depthTexture);
+		}
+
+		this->width = width;
+		this->height = height;
+
+		accumulationTexture = createTarget(GL_RGBA16F);
+		revealageTexture = createTarget(GL_R8);
+		depthTexture = createTarget(GL_DEPTH24_STENCIL8);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulationTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, revealageTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+		const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "Weighted blended OIT framebuffer is incomplete" << '\n';
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	unsigned int createTarget(GLenum format) const
+	{
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		GLState::getInstance().bindTexture(0, GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		return texture;
+	}
+};
@@ -0,0 +1,701 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "drawable.h"
+#include "materiallibrary.h"
+#include "occlusionculler.h"
+#include "transformable.h"
+#include "vertexarrayobject.h"
+
+// One bit per component, an entity's mask picks the archetype that stores it
+namespace Component
+{
+	const uint32_t Transform = 1 << 0; // Position, Rotation and Scale relative to the parent, and LocalToWorld
+	const uint32_t Velocity = 1 << 1; // Linear and angular, integrated into the transform
+	const uint32_t RenderMesh = 1 << 2;
+	const uint32_t Material = 1 << 3;
+	const uint32_t WorldBounds = 1 << 4; // The render mesh's bounds moved by LocalToWorld
+	const uint32_t Occluder = 1 << 5; // Local space, owned by AssetManager
+	const uint32_t GPUCulled = 1 << 6; // Drawn through a GPUCuller handle instead of a RenderQueue
+	const uint32_t StaticMeshes = 1 << 7; // Root of an instantiated drawable, culls its submeshes through the drawable's BVH
+	const uint32_t BVHCulled = 1 << 8; // Submesh found through its root's StaticMeshes instead of on its own
+}
+
+// Index and generation, so a handle to a destroyed entity never reaches its slot's next owner
+struct Entity
+{
+	static const uint32_t InvalidIndex = 0xFFFFFFFF;
+
+	uint32_t Index;
+	uint32_t Generation;
+
+	Entity() : Index(InvalidIndex), Generation(0) { }
+	Entity(uint32_t index, uint32_t generation) : Index(index), Generation(generation) { }
+};
+
+// Submeshes of an instantiated drawable that keep their place under the root. The hierarchy was
+// built over their bounds in the root's space, so it is queried there and never rebuilt.
+struct StaticMeshSet
+{
+	const BVH* Hierarchy; // Owned by AssetManager
+	std::vector<Entity> Submeshes; // Indexed like the BVH's primitives
+};
+
+// Every entity with the same component mask, one array per component field. Row i of each
+// array belongs to Entities[i], arrays of components outside the mask stay empty.
+struct Archetype
+{
+	uint32_t Mask;
+	std::vector<Entity> Entities;
+
+	std::vector<glm::vec3> Positions;
+	std::vector<glm::vec3> Rotations; // Euler angles, as in Transformable
+	std::vector<glm::vec3> Scales;
+	std::vector<glm::mat4> LocalToWorld;
+	std::vector<glm::vec3> LinearVelocities;
+	std::vector<glm::vec3> AngularVelocities;
+	std::vector<VertexArrayObject> Meshes;
+	std::vector<MaterialID> Materials;
+	std::vector<Bounds> WorldBounds;
+	std::vector<const OccluderMesh*> Occluders;
+	std::vector<uint32_t> GPUHandles;
+	std::vector<StaticMeshSet> StaticMeshes;
+
+	size_t size() const
+	{
+		return Entities.size();
+	}
+
+	// Calls fn(a's column, b's column) for every column of the components in mask
+	template<typename A, typename B, typename Fn>
+	static void forEachColumn(A& a, B& b, uint32_t mask, Fn fn)
+	{
+		if (mask & Component::Transform)
+		{
+			fn(a.Positions, b.Positions);
+			fn(a.Rotations, b.Rotations);
+			fn(a.Scales, b.Scales);
+			fn(a.LocalToWorld, b.LocalToWorld);
+		}
+		if (mask & Component::Velocity)
+		{
+			fn(a.LinearVelocities, b.LinearVelocities);
+			fn(a.AngularVelocities, b.AngularVelocities);
+		}
+		if (mask & Component::RenderMesh)
+			fn(a.Meshes, b.Meshes);
+		if (mask & Component::Material)
+			fn(a.Materials, b.Materials);
+		if (mask & Component::WorldBounds)
+			fn(a.WorldBounds, b.WorldBounds);
+		if (mask & Component::Occluder)
+			fn(a.Occluders, b.Occluders);
+		if (mask & Component::GPUCulled)
+			fn(a.GPUHandles, b.GPUHandles);
+		if (mask & Component::StaticMeshes)
+			fn(a.StaticMeshes, b.StaticMeshes);
+	}
+};
+
+struct SegmentHit
+{
+	Entity Submesh;
+	float Fraction; // Along the segment, 0 at its start
+};
+
+// Where an entity's components are, until the next structural change
+struct EntityRef
+{
+	Archetype* Table;
+	uint32_t Row;
+};
+
+// Entity storage grouped by archetype. Systems walk whole archetypes at once, so their loops
+// run over contiguous arrays of exactly the components they use, with no virtual calls and no
+// per object allocations. Adding or removing components moves the entity to another archetype.
+// Creating, destroying or moving entities invalidates EntityRefs and pointers into the arrays.
+// Transforms form a hierarchy kept as one flat array in depth first order, so every subtree is
+// a contiguous range behind its root. Only entities marked dirty and their subtrees have their
+// LocalToWorld rebuilt, and a frame where nothing moved costs nothing. The order itself is
+// rebuilt on the next update after entities with transforms are created, destroyed or
+// reparented.
+class World
+{
+public:
+	World()
+	{
+		hierarchyChanged = false;
+	}
+
+	World(World const&) = delete;
+	void operator=(World const&) = delete;
+
+	static constexpr uint32_t NoParent = 0xFFFFFFFF;
+
+	// Components start zeroed, with unit scale, identity LocalToWorld and no GPU handle. Transforms
+	// start as roots and dirty.
+	Entity create(uint32_t mask)
+	{
+		uint32_t index;
+		if (!freeIndices.empty())
+		{
+			index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else
+		{
+			index = (uint32_t)records.size();
+			records.push_back({ NoArchetype, 0, 0, NoParent, NoNode, false });
+		}
+
+		Entity entity(index, records[index].Generation);
+		uint32_t archetype = getArchetype(mask);
+		records[index].Archetype = archetype;
+		records[index].Row = pushRow(*archetypes[archetype], entity);
+		records[index].Parent = NoParent;
+		if (mask & Component::Transform)
+		{
+			hierarchyChanged = true;
+			markDirty(entity);
+		}
+		return entity;
+	}
+
+	// Takes the entity's children and their descendants with it
+	void destroy(Entity entity)
+	{
+		if (!isAlive(entity))
+			return;
+
+		if ((getMask(entity) & Component::Transform) == 0)
+		{
+			release(entity.Index);
+			return;
+		}
+
+		updateHierarchy();
+		uint32_t node = records[entity.Index].Node;
+		std::vector<uint32_t> subtree(nodeEntities.begin() + node, nodeEntities.begin() + node + subtreeSizes[node]);
+		for (uint32_t index : subtree)
+			release(index);
+		hierarchyChanged = true;
+	}
+
+	bool isAlive(Entity entity) const
+	{
+		return entity.Index < records.size() && records[entity.Index].Generation == entity.Generation;
+	}
+
+	// Attaches child under parent, or makes it a root again when parent is not alive. Its transform
+	// is kept as it is, now relative to the new parent. Both need a Transform, and parent may not
+	// be one of child's descendants.
+	void setParent(Entity child, Entity parent)
+	{
+		if (!isAlive(child) || (getMask(child) & Component::Transform) == 0)
+			return;
+
+		uint32_t parentIndex = NoParent;
+		if (isAlive(parent))
+		{
+			if ((getMask(parent) & Component::Transform) == 0)
+				return;
+
+			for (uint32_t ancestor = parent.Index; ancestor != NoParent; ancestor = records[ancestor].Parent)
+			{
+				if (ancestor == child.Index)
+				{
+					std::cout << "Cannot parent an entity to its own descendant" << '\n';
+					return;
+				}
+			}
+			parentIndex = parent.Index;
+		}
+
+		records[child.Index].Parent = parentIndex;
+		hierarchyChanged = true;
+		markDirty(child);
+	}
+
+	Entity getParent(Entity entity) const
+	{
+		uint32_t parent = records[entity.Index].Parent;
+		return parent != NoParent ? Entity(parent, records[parent].Generation) : Entity();
+	}
+
+	// Call after writing Position, Rotation or Scale, so the next updateTransforms() picks it up
+	void markDirty(Entity entity)
+	{
+		EntityRecord& record = records[entity.Index];
+		if (record.Dirty)
+			return;
+
+		record.Dirty = true;
+		dirtyEntities.push_back(entity.Index);
+	}
+
+	// Entities whose LocalToWorld the last updateTransforms() rebuilt, for systems that mirror
+	// transforms elsewhere and only want to copy what moved
+	const std::vector<Entity>& getChangedEntities() const
+	{
+		return changedEntities;
+	}
+
+	// As of the last updateTransforms()
+	glm::vec3 getWorldPosition(Entity entity)
+	{
+		EntityRef ref = get(entity);
+		return glm::vec3(ref.Table->LocalToWorld[ref.Row][3]);
+	}
+
+	EntityRef get(Entity entity) const
+	{
+		const EntityRecord& record = records[entity.Index];
+		return { archetypes[record.Archetype].get(), record.Row };
+	}
+
+	uint32_t getMask(Entity entity) const
+	{
+		return archetypes[records[entity.Index].Archetype]->Mask;
+	}
+
+	// Moves the entity to the archetype with the components added, new ones start as in create()
+	void addComponents(Entity entity, uint32_t mask)
+	{
+		setMask(entity, getMask(entity) | mask);
+	}
+
+	void removeComponents(Entity entity, uint32_t mask)
+	{
+		setMask(entity, getMask(entity) & ~mask);
+	}
+
+	// Calls fn(archetype) for every non empty archetype with all of the required components and
+	// none of the excluded ones
+	template<typename Fn>
+	void forEach(uint32_t required, uint32_t excluded, Fn fn)
+	{
+		for (std::unique_ptr<Archetype>& archetype : archetypes)
+		{
+			if ((archetype->Mask & required) == required && (archetype->Mask & excluded) == 0 && archetype->size() > 0)
+				fn(*archetype);
+		}
+	}
+
+	template<typename Fn>
+	void forEach(uint32_t required, uint32_t excluded, Fn fn) const
+	{
+		for (const std::unique_ptr<Archetype>& archetype : archetypes)
+		{
+			if ((archetype->Mask & required) == required && (archetype->Mask & excluded) == 0 && archetype->size() > 0)
+				fn((const Archetype&)*archetype);
+		}
+	}
+
+	template<typename Fn>
+	void forEach(uint32_t required, Fn fn)
+	{
+		forEach(required, 0, fn);
+	}
+
+	template<typename Fn>
+	void forEach(uint32_t required, Fn fn) const
+	{
+		forEach(required, 0, fn);
+	}
+
+	// A root entity placed at position, with one child per submesh and one per occluder, so the
+	// object moves as a whole through the root. extraMask is added to the submeshes' components,
+	// e.g. GPUCulled. Unless they are GPU culled, submeshes of a drawable with a static BVH are
+	// BVHCulled and found through the root. Remove BVHCulled from a submesh before moving it on
+	// its own, it is then culled by its world bounds like any other entity.
+	Entity instantiate(const Drawable& drawable, const glm::vec3& position, uint32_t extraMask = 0)
+	{
+		bool useBVH = drawable.StaticBVH != nullptr && (extraMask & Component::GPUCulled) == 0;
+		Entity root = create(Component::Transform | (useBVH ? Component::StaticMeshes : 0));
+		EntityRef rootRef = get(root);
+		rootRef.Table->Positions[rootRef.Row] = position;
+
+		StaticMeshSet meshSet = { drawable.StaticBVH, {} };
+		uint32_t meshMask = Component::Transform | Component::RenderMesh | Component::Material | Component::WorldBounds | extraMask;
+		if (useBVH)
+			meshMask |= Component::BVHCulled;
+
+		for (size_t i = 0; i < drawable.VAOs.size(); i++)
+		{
+			Entity entity = create(meshMask);
+			EntityRef ref = get(entity);
+			ref.Table->Meshes[ref.Row] = drawable.VAOs[i];
+			ref.Table->Materials[ref.Row] = drawable.Materials[i];
+			setParent(entity, root);
+			meshSet.Submeshes.push_back(entity);
+		}
+
+		if (useBVH)
+		{
+			rootRef = get(root);
+			rootRef.Table->StaticMeshes[rootRef.Row] = std::move(meshSet);
+		}
+
+		if (drawable.Occluders != nullptr)
+		{
+			for (const OccluderMesh& occluder : *drawable.Occluders)
+			{
+				Entity entity = create(Component::Transform | Component::Occluder);
+				EntityRef ref = get(entity);
+				ref.Table->Occluders[ref.Row] = &occluder;
+				setParent(entity, root);
+			}
+		}
+
+		return root;
+	}
+
+	// Nearest BVHCulled submesh whose bounds the segment enters, as of the last updateTransforms().
+	// Each root's hierarchy is tested in the root's space. Bounds that already hold from do not
+	// count, so whatever starts inside one can always move out.
+	bool intersectSegment(const glm::vec3& from, const glm::vec3& to, SegmentHit& hit) const
+	{
+		hit.Submesh = Entity();
+		hit.Fraction = 1.0f;
+
+		forEach(Component::Transform | Component::StaticMeshes, [&](const Archetype& archetype)
+		{
+			for (size_t i = 0; i < archetype.size(); i++)
+			{
+				const StaticMeshSet& meshSet = archetype.StaticMeshes[i];
+				glm::mat4 worldToRoot = glm::affineInverse(archetype.LocalToWorld[i]);
+				glm::vec3 localFrom = glm::vec3(worldToRoot * glm::vec4(from, 1.0f));
+				glm::vec3 localTo = glm::vec3(worldToRoot * glm::vec4(to, 1.0f));
+				float length = glm::length(localTo - localFrom);
+
+				auto accept = [&](uint32_t primitive)
+				{
+					Entity entity = meshSet.Submeshes[primitive];
+					if (!isAlive(entity) || (getMask(entity) & Component::BVHCulled) == 0)
+						return false;
+
+					const BVHPrimitive& bounds = meshSet.Hierarchy->PrimitiveBounds[primitive];
+					return !(glm::all(glm::greaterThanEqual(localFrom, bounds.Min)) && glm::all(glm::lessThanEqual(localFrom, bounds.Max)));
+				};
+
+				// Only up to the nearest hit of the roots before
+				BVHHit bvhHit;
+				glm::vec3 localEnd = localFrom + (localTo - localFrom) * hit.Fraction;
+				if (meshSet.Hierarchy->intersectSegment(localFrom, localEnd, bvhHit, accept))
+				{
+					hit.Submesh = meshSet.Submeshes[bvhHit.Primitive];
+					hit.Fraction = bvhHit.Distance / length;
+				}
+			}
+		});
+
+		return hit.Submesh.Index != Entity::InvalidIndex;
+	}
+
+	// Motion system, velocities into positions and rotations. Anything with a velocity is taken
+	// to be moving.
+	void integrate(float deltaTime)
+	{
+		forEach(Component::Transform | Component::Velocity, [&](Archetype& archetype)
+		{
+			size_t count = archetype.size();
+			for (size_t i = 0; i < count; i++)
+			{
+				archetype.Positions[i] += archetype.LinearVelocities[i] * deltaTime;
+				archetype.Rotations[i] += archetype.AngularVelocities[i] * deltaTime;
+				markDirty(archetype.Entities[i]);
+			}
+		});
+	}
+
+	// Transform system, rebuilds LocalToWorld of the dirty entities and their descendants, and the
+	// world bounds that depend on it. A few dirty subtrees are found through the sorted dirty list,
+	// when many are dirty one pass over the whole order is cheaper.
+	void updateTransforms()
+	{
+		updateHierarchy();
+		changedEntities.clear();
+		if (dirtyEntities.empty())
+			return;
+
+		dirtyNodes.clear();
+		for (uint32_t index : dirtyEntities)
+		{
+			EntityRecord& record = records[index];
+			record.Dirty = false;
+			if (record.Node != NoNode)
+				dirtyNodes.push_back(record.Node);
+		}
+		dirtyEntities.clear();
+
+		uint32_t nodeCount = (uint32_t)nodeEntities.size();
+		if (dirtyNodes.size() * 8 < nodeCount)
+		{
+			std::sort(dirtyNodes.begin(), dirtyNodes.end());
+
+			// Descendants come right after their root, so a subtree already done is skipped whole
+			uint32_t end = 0;
+			for (uint32_t node : dirtyNodes)
+			{
+				if (node < end)
+					continue;
+
+				end = node + subtreeSizes[node];
+				for (uint32_t i = node; i < end; i++)
+					updateNode(i);
+			}
+		}
+		else
+		{
+			nodeDirty.assign(nodeCount, 0);
+			for (uint32_t node : dirtyNodes)
+				nodeDirty[node] = 1;
+
+			// Parents come first, so their flag is final by the time a child reads it
+			for (uint32_t i = 0; i < nodeCount; i++)
+			{
+				if (nodeParents[i] != NoNode)
+					nodeDirty[i] |= nodeDirty[nodeParents[i]];
+				if (nodeDirty[i])
+					updateNode(i);
+			}
+		}
+	}
+
+private:
+	static constexpr uint32_t NoArchetype = 0xFFFFFFFF;
+	static constexpr uint32_t NoNode = 0xFFFFFFFF;
+
+	struct EntityRecord
+	{
+		uint32_t Archetype;
+		uint32_t Row;
+		uint32_t Generation;
+		uint32_t Parent; // Entity index
+		uint32_t Node; // Position in the hierarchy order, NoNode without a Transform
+		bool Dirty;
+	};
+
+	// Owned through pointers so an archetype's arrays stay put as archetypes are added
+	std::vector<std::unique_ptr<Archetype>> archetypes;
+	std::unordered_map<uint32_t, uint32_t> archetypeIndices;
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeIndices;
+
+	// Hierarchy, indexed by node in depth first order
+	std::vector<uint32_t> nodeEntities;
+	std::vector<uint32_t> nodeParents;
+	std::vector<uint32_t> subtreeSizes; // The node itself included
+	std::vector<glm::mat4> nodeWorlds;
+	bool hierarchyChanged;
+	std::vector<uint32_t> dirtyEntities;
+	std::vector<Entity> changedEntities;
+	std::vector<uint32_t> dirtyNodes;
+	std::vector<uint8_t> nodeDirty;
+	std::vector<uint32_t> childOffsets;
+	std::vector<uint32_t> children;
+	std::vector<uint32_t> stack;
+
+	void release(uint32_t index)
+	{
+		EntityRecord& record = records[index];
+		removeRow(*archetypes[record.Archetype], record.Row);
+		record.Archetype = NoArchetype;
+		record.Parent = NoParent;
+		record.Generation++;
+		freeIndices.push_back(index);
+	}
+
+	bool hasTransform(uint32_t index) const
+	{
+		uint32_t archetype = records[index].Archetype;
+		return archetype != NoArchetype && (archetypes[archetype]->Mask & Component::Transform) != 0;
+	}
+
+	void updateNode(uint32_t node)
+	{
+		const EntityRecord& record = records[nodeEntities[node]];
+		Archetype& archetype = *archetypes[record.Archetype];
+		uint32_t row = record.Row;
+		changedEntities.push_back(archetype.Entities[row]);
+
+		glm::mat4 local = Transformable::compose(archetype.Positions[row], archetype.Rotations[row], archetype.Scales[row]);
+		uint32_t parent = nodeParents[node];
+		glm::mat4 world = parent != NoNode ? nodeWorlds[parent] * local : local;
+		nodeWorlds[node] = world;
+		archetype.LocalToWorld[row] = world;
+
+		if ((archetype.Mask & (Component::RenderMesh | Component::WorldBounds)) == (Component::RenderMesh | Component::WorldBounds))
+			archetype.WorldBounds[row] = archetype.Meshes[row].LocalBounds.transformed(world);
+	}
+
+	// Lays out every entity with a Transform depth first, children in entity order. World
+	// matrices move along with their nodes, so only the entities that changed need updating.
+	void updateHierarchy()
+	{
+		if (!hierarchyChanged)
+			return;
+		hierarchyChanged = false;
+
+		uint32_t count = (uint32_t)records.size();
+		childOffsets.assign(count + 1, 0);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (hasTransform(i) && records[i].Parent != NoParent)
+				childOffsets[records[i].Parent + 1]++;
+		}
+		for (uint32_t i = 0; i < count; i++)
+			childOffsets[i + 1] += childOffsets[i];
+
+		children.resize(childOffsets[count]);
+		std::vector<uint32_t> fill(childOffsets.begin(), childOffsets.end() - 1);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (hasTransform(i) && records[i].Parent != NoParent)
+				children[fill[records[i].Parent]++] = i;
+		}
+
+		std::vector<glm::mat4> previousWorlds;
+		previousWorlds.swap(nodeWorlds);
+		nodeEntities.clear();
+		nodeParents.clear();
+
+		for (uint32_t root = 0; root < count; root++)
+		{
+			if (!hasTransform(root) || records[root].Parent != NoParent)
+				continue;
+
+			stack.push_back(root);
+			while (!stack.empty())
+			{
+				uint32_t index = stack.back();
+				stack.pop_back();
+
+				EntityRecord& record = records[index];
+				uint32_t node = (uint32_t)nodeEntities.size();
+				nodeEntities.push_back(index);
+				nodeParents.push_back(record.Parent != NoParent ? records[record.Parent].Node : NoNode);
+				nodeWorlds.push_back(record.Node != NoNode && record.Node < previousWorlds.size() ? previousWorlds[record.Node] : glm::mat4(1.0f));
+				record.Node = node;
+
+				// Reversed, so the first child is laid out first
+				for (uint32_t i = childOffsets[index + 1]; i > childOffsets[index]; i--)
+					stack.push_back(children[i - 1]);
+			}
+		}
+
+		subtreeSizes.assign(nodeEntities.size(), 1);
+		for (uint32_t i = (uint32_t)nodeEntities.size(); i-- > 1;)
+		{
+			if (nodeParents[i] != NoNode)
+				subtreeSizes[nodeParents[i]] += subtreeSizes[i];
+		}
+
+		// Whatever lost its transform is out of the order now
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (!hasTransform(i))
+				records[i].Node = NoNode;
+		}
+	}
+
+	uint32_t getArchetype(uint32_t mask)
+	{
+		auto itr = archetypeIndices.find(mask);
+		if (itr != archetypeIndices.end())
+			return itr->second;
+
+		uint32_t index = (uint32_t)archetypes.size();
+		archetypes.push_back(std::make_unique<Archetype>());
+		archetypes.back()->Mask = mask;
+		archetypeIndices.insert(std::make_pair(mask, index));
+		return index;
+	}
+
+	static uint32_t pushRow(Archetype& archetype, Entity entity)
+	{
+		archetype.Entities.push_back(entity);
+		Archetype::forEachColumn(archetype, archetype, archetype.Mask, [](auto& column, auto&)
+		{
+			column.emplace_back();
+		});
+
+		if (archetype.Mask & Component::Transform)
+		{
+			archetype.Scales.back() = glm::vec3(1.0f);
+			archetype.LocalToWorld.back() = glm::mat4(1.0f);
+		}
+		if (archetype.Mask & Component::GPUCulled)
+			archetype.GPUHandles.back() = 0xFFFFFFFF;
+
+		return (uint32_t)archetype.size() - 1;
+	}
+
+	// Swaps the last row into the gap and repoints its entity
+	void removeRow(Archetype& archetype, uint32_t row)
+	{
+		uint32_t last = (uint32_t)archetype.size() - 1;
+		if (row != last)
+		{
+			archetype.Entities[row] = archetype.Entities[last];
+			records[archetype.Entities[row].Index].Row = row;
+		}
+		archetype.Entities.pop_back();
+
+		Archetype::forEachColumn(archetype, archetype, archetype.Mask, [&](auto& column, auto&)
+		{
+			column[row] = column[last];
+			column.pop_back();
+		});
+	}
+
+	void setMask(Entity entity, uint32_t mask)
+	{
+		if (!isAlive(entity))
+			return;
+
+		EntityRecord& record = records[entity.Index];
+		uint32_t target = getArchetype(mask);
+		if (target == record.Archetype)
+			return;
+
+		Archetype& from = *archetypes[record.Archetype];
+		Archetype& to = *archetypes[target];
+		uint32_t row = pushRow(to, entity);
+		Archetype::forEachColumn(to, from, to.Mask & from.Mask, [&](auto& toColumn, auto& fromColumn)
+		{
+			toColumn[row] = fromColumn[record.Row];
+		});
+
+		removeRow(from, record.Row);
+		record.Archetype = target;
+		record.Row = row;
+
+		// Children of an entity that loses its transform become roots
+		if ((from.Mask ^ to.Mask) & Component::Transform)
+		{
+			if (to.Mask & Component::Transform)
+				markDirty(entity);
+			else
+			{
+				for (EntityRecord& other : records)
+				{
+					if (other.Parent == entity.Index)
+						other.Parent = NoParent;
+				}
+				record.Parent = NoParent;
+			}
+			hierarchyChanged = true;
+		}
+	}
+};